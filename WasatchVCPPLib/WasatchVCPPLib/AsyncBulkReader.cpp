@@ -0,0 +1,296 @@
+/**
+    @file   AsyncBulkReader.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::AsyncBulkReader
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "AsyncBulkReader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using std::vector;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::max;
+using std::min;
+
+////////////////////////////////////////////////////////////////////////////////
+// Event thread (libusb-1.0 only)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef USE_LIBUSB_WIN32
+mutex WasatchVCPP::AsyncBulkReader::mutEventThread;
+std::thread WasatchVCPP::AsyncBulkReader::eventThread;
+std::atomic<bool> WasatchVCPP::AsyncBulkReader::eventThreadRunning(false);
+int WasatchVCPP::AsyncBulkReader::eventThreadUsers = 0;
+
+//! All transfer callbacks are invoked from within libusb_handle_events, so
+//! something has to keep calling it.  The short timeout only bounds how long
+//! stopEventThread() has to wait; completions are delivered immediately.
+void WasatchVCPP::AsyncBulkReader::handleEvents()
+{
+    while (eventThreadRunning)
+    {
+        struct timeval tv = { 0, 100000 };
+        libusb_handle_events_timeout_completed(nullptr, &tv, nullptr);
+    }
+}
+
+void WasatchVCPP::AsyncBulkReader::startEventThread()
+{
+    lock_guard<mutex> lock(mutEventThread);
+    if (eventThreadUsers++ == 0)
+    {
+        eventThreadRunning = true;
+        eventThread = std::thread(handleEvents);
+    }
+}
+
+void WasatchVCPP::AsyncBulkReader::stopEventThread()
+{
+    lock_guard<mutex> lock(mutEventThread);
+    if (--eventThreadUsers == 0)
+    {
+        eventThreadRunning = false;
+        if (eventThread.joinable())
+            eventThread.join();
+    }
+}
+
+//! Translate a completed transfer's status into the result code
+//! libusb_bulk_transfer would have returned.
+static int toResult(libusb_transfer_status status)
+{
+    switch (status)
+    {
+        case LIBUSB_TRANSFER_COMPLETED: return 0;
+        case LIBUSB_TRANSFER_TIMED_OUT: return LIBUSB_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_CANCELLED: return LIBUSB_ERROR_INTERRUPTED;
+        case LIBUSB_TRANSFER_STALL:     return LIBUSB_ERROR_PIPE;
+        case LIBUSB_TRANSFER_NO_DEVICE: return LIBUSB_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW:  return LIBUSB_ERROR_OVERFLOW;
+        default:                        return LIBUSB_ERROR_IO;
+    }
+}
+
+//! called on the event thread
+void LIBUSB_CALL WasatchVCPP::AsyncBulkReader::onTransferComplete(libusb_transfer* transfer)
+{
+    Slot* slot = (Slot*)transfer->user_data;
+    AsyncBulkReader* reader = slot->reader;
+
+    lock_guard<mutex> lock(reader->mutSlots);
+    slot->actual = transfer->actual_length;
+    slot->result = toResult(transfer->status);
+    slot->inFlight = false;
+    if (slot->result != 0 || slot->actual < slot->len)
+        reader->cancelAfter((int)(slot - reader->slots.data()));
+    reader->pending--;
+    reader->cvComplete.notify_all();
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Lifecycle
+////////////////////////////////////////////////////////////////////////////////
+
+WasatchVCPP::AsyncBulkReader::AsyncBulkReader(WPVCPP_UDEV_TYPE* udev, int transfers, Logger& logger)
+    : udev(udev), logger(logger)
+{
+    slots.resize(max(1, min(MAX_TRANSFERS, transfers)));
+
+#ifndef USE_LIBUSB_WIN32
+    for (auto& slot : slots)
+    {
+        slot.transfer = libusb_alloc_transfer(0);
+        slot.reader = this;
+    }
+    startEventThread();
+#endif
+
+    logger.debug("AsyncBulkReader::ctor: %d transfers in flight", (int)slots.size());
+}
+
+WasatchVCPP::AsyncBulkReader::~AsyncBulkReader()
+{
+    cancel();
+
+#ifdef USE_LIBUSB_WIN32
+    for (auto& pair : contexts)
+        for (auto& context : pair.second)
+            usb_free_async(&context);
+#else
+    {
+        unique_lock<mutex> lock(mutSlots);
+        cvComplete.wait(lock, [this] { return pending == 0; });
+    }
+
+    for (auto& slot : slots)
+        libusb_free_transfer(slot.transfer);
+
+    stopEventThread();
+#endif
+}
+
+int WasatchVCPP::AsyncBulkReader::getTransferCount() { return (int)slots.size(); }
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef USE_LIBUSB_WIN32
+bool WasatchVCPP::AsyncBulkReader::setupContexts(uint8_t ep)
+{
+    vector<void*>& epContexts = contexts[ep];
+    while (epContexts.size() < slots.size())
+    {
+        void* context = nullptr;
+        int result = usb_bulk_setup_async(udev, &context, ep);
+        if (result < 0)
+        {
+            logger.error("AsyncBulkReader: unable to setup endpoint 0x%02x (%s)", ep, usb_strerror());
+            return false;
+        }
+        epContexts.push_back(context);
+    }
+    return true;
+}
+#endif
+
+//! Read 'len' bytes from the given bulk endpoint using up to getTransferCount()
+//! concurrent transfers.
+//!
+//! @param ep (Input) bulk endpoint
+//! @param data (Output) destination buffer of at least 'len' bytes
+//! @param len (Input) bytes requested
+//! @param bytesRead (Output) contiguous bytes actually received
+//! @param timeoutMS (Input) per-transfer timeout (0 for none)
+//! @returns 0 on success, else a (negative) libusb error code, exactly as
+//!          libusb_bulk_transfer would (usb_bulk_read codes on libusb-win32)
+int WasatchVCPP::AsyncBulkReader::read(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS)
+{
+    *bytesRead = 0;
+    if (len <= 0)
+        return 0;
+
+    // carve the request into packet-aligned chunks, one per slot
+    int count = (int)slots.size();
+    int chunk = (len + count - 1) / count;
+    chunk = ((chunk + PACKET_SIZE - 1) / PACKET_SIZE) * PACKET_SIZE;
+
+#ifdef USE_LIBUSB_WIN32
+    if (!setupContexts(ep))
+        return -1;
+    vector<void*>& epContexts = contexts[ep];
+#endif
+
+    int used = 0;
+    int submitResult = 0;
+    {
+        lock_guard<mutex> lock(mutSlots);
+        for (int offset = 0; offset < len && used < count; offset += chunk)
+        {
+            Slot& slot = slots[used];
+            slot.offset = offset;
+            slot.len = min(chunk, len - offset);
+            slot.actual = 0;
+            slot.result = 0;
+
+#ifdef USE_LIBUSB_WIN32
+            slot.context = epContexts[used];
+            submitResult = usb_submit_async(slot.context, (char*)data + offset, slot.len);
+#else
+            libusb_fill_bulk_transfer(slot.transfer, udev, ep, data + offset, slot.len,
+                onTransferComplete, &slot, timeoutMS);
+            submitResult = libusb_submit_transfer(slot.transfer);
+#endif
+            if (submitResult < 0)
+            {
+                logger.error("AsyncBulkReader: failed to submit transfer %d on endpoint 0x%02x (result %d)",
+                    used, ep, submitResult);
+                break;
+            }
+
+            slot.inFlight = true;
+            pending++;
+            used++;
+        }
+    }
+
+    if (submitResult < 0)
+        cancel();
+
+    // wait for everything we submitted to complete
+#ifdef USE_LIBUSB_WIN32
+    for (int i = 0; i < used; i++)
+    {
+        Slot& slot = slots[i];
+        // (-1 is INFINITE to the underlying WaitForSingleObject)
+        int result = usb_reap_async(slot.context, timeoutMS > 0 ? timeoutMS : -1);
+
+        lock_guard<mutex> lock(mutSlots);
+        slot.actual = result > 0 ? result : 0;
+        slot.result = result < 0 ? result : 0;
+        slot.inFlight = false;
+        if (slot.result != 0 || slot.actual < slot.len)
+            cancelAfter(i);
+        pending--;
+    }
+#else
+    {
+        unique_lock<mutex> lock(mutSlots);
+        cvComplete.wait(lock, [this] { return pending == 0; });
+    }
+#endif
+
+    // Bulk transfers complete in submission order, so the bytes each chunk
+    // actually received are consecutive in the device's stream; close any
+    // gaps left by short chunks.  The result is that of the first chunk to 
+    // end short or fail (later chunks were cancelled by us), but bytes which
+    // arrived in later chunks are kept, as they're already out of the device.
+    int result = 0;
+    int total = 0;
+    bool ended = false;
+    for (int i = 0; i < used; i++)
+    {
+        Slot& slot = slots[i];
+        if (slot.actual > 0 && slot.offset != total)
+            memmove(data + total, data + slot.offset, slot.actual);
+        total += slot.actual;
+
+        if (!ended && (slot.result != 0 || slot.actual < slot.len))
+        {
+            ended = true;
+            result = slot.result;
+        }
+    }
+
+    *bytesRead = total;
+    return result != 0 ? result : submitResult;
+}
+
+//! Cancel all in-flight transfers (may be called from any thread).  The
+//! pending read() will return with whatever was received so far.
+void WasatchVCPP::AsyncBulkReader::cancel()
+{
+    lock_guard<mutex> lock(mutSlots);
+    cancelAfter(-1);
+}
+
+//! Cancel the in-flight transfers after slots[index], once a chunk has ended
+//! the device's transfer early (mutSlots held).
+void WasatchVCPP::AsyncBulkReader::cancelAfter(int index)
+{
+    for (int i = index + 1; i < (int)slots.size(); i++)
+        if (slots[i].inFlight)
+#ifdef USE_LIBUSB_WIN32
+            usb_cancel_async(slots[i].context);
+#else
+            libusb_cancel_transfer(slots[i].transfer);
+#endif
+}
@@ -0,0 +1,118 @@
+/**
+    @file   AsyncBulkReader.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::AsyncBulkReader
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#ifdef USE_LIBUSB_WIN32
+#include "libusb.h"
+#define WPVCPP_UDEV_TYPE usb_dev_handle
+#else
+//#include <libusb-1_0.h>
+#include <libusb.h>
+#define WPVCPP_UDEV_TYPE libusb_device_handle
+#endif
+
+#include "Logger.h"
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+namespace WasatchVCPP
+{
+    //! Internal class reading bulk endpoints through the asynchronous libusb
+    //! API, keeping several transfers "in flight" per spectrum.
+    //!
+    //! The synchronous libusb_bulk_transfer / usb_bulk_read calls used by
+    //! Spectrometer::getSubspectrum submit exactly one URB and then sleep until
+    //! it completes, so the host controller sits idle between the completion of
+    //! one read and the submission of the next.  This class instead carves the
+    //! requested read into several packet-aligned chunks, submits all of them
+    //! at once, and lets the host controller fill them back-to-back.
+    //!
+    //! Because bulk transfers on a given endpoint complete strictly in the
+    //! order they were submitted, concatenating the bytes actually received by
+    //! each chunk reproduces the device's byte stream, with no gaps or loss.
+    //! When a chunk ends short (or fails, e.g. times out), the chunks after it
+    //! are cancelled at once rather than left to wait out their timeouts.  Any
+    //! bytes those later chunks had already received are still returned, so 
+    //! such a read may return bytes beyond the short packet which a single 
+    //! synchronous read would only have returned on the next call.  Otherwise
+    //! read() mimics the signature and result codes of libusb_bulk_transfer,
+    //! so callers can swap one for the other.
+    //!
+    //! On libusb-1.0, completions are delivered by a single event-handling
+    //! thread shared by all readers (started with the first reader and stopped
+    //! with the last).  On libusb-win32, usb_reap_async serves the same purpose
+    //! and no extra thread is needed.
+    class AsyncBulkReader
+    {
+        public:
+            //! transfers are sized in multiples of the high-speed bulk packet
+            //! size, so that no transfer ends mid-packet (which would overflow)
+            static const int PACKET_SIZE = 512;
+
+            static const int MAX_TRANSFERS = 32;
+
+            AsyncBulkReader(WPVCPP_UDEV_TYPE* udev, int transfers, Logger& logger);
+            ~AsyncBulkReader();
+
+            int read(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS);
+            void cancel();
+
+            int getTransferCount();
+
+        private:
+            //! one "in-flight" portion of the current read
+            struct Slot
+            {
+                int offset = 0;             //!< where this chunk starts within the caller's buffer
+                int len = 0;                //!< bytes requested by this chunk
+                int actual = 0;             //!< bytes actually received
+                int result = 0;             //!< libusb-style result code
+                bool inFlight = false;
+#ifdef USE_LIBUSB_WIN32
+                void* context = nullptr;    //!< usb_bulk_setup_async context
+#else
+                libusb_transfer* transfer = nullptr;
+                AsyncBulkReader* reader = nullptr;
+#endif
+            };
+
+            WPVCPP_UDEV_TYPE* udev = nullptr;
+            Logger& logger;
+
+            std::vector<Slot> slots;
+            int pending = 0;
+
+            void cancelAfter(int index);
+
+            std::mutex mutSlots;
+            std::condition_variable cvComplete;
+
+#ifdef USE_LIBUSB_WIN32
+            //! libusb-win32 binds async contexts to a single endpoint
+            std::map<uint8_t, std::vector<void*> > contexts;
+            bool setupContexts(uint8_t ep);
+#else
+            static void LIBUSB_CALL onTransferComplete(libusb_transfer* transfer);
+
+            static void startEventThread();
+            static void stopEventThread();
+            static void handleEvents();
+
+            static std::mutex mutEventThread;
+            static std::thread eventThread;
+            static std::atomic<bool> eventThreadRunning;
+            static int eventThreadUsers;
+#endif
+    };
+}
@@ -0,0 +1,197 @@
+/**
+    @file   BaselineRemover.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::BaselineRemover
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "BaselineRemover.h"
+
+#include <cmath>
+#include <algorithm>
+
+using std::vector;
+
+//! @returns false (leaving the configuration unchanged) if a parameter is
+//!          out of range
+bool WasatchVCPP::BaselineRemover::configure(Method method, double lambda, double p, int maxIterations)
+{
+    if (method != METHOD_NONE)
+    {
+        if (!(lambda > 0) || maxIterations < 1)
+            return false;
+        if (method == METHOD_ALS && !(p > 0 && p < 1))
+            return false;
+    }
+
+    this->method = method;
+    this->lambda = lambda;
+    this->p = p;
+    this->maxIterations = maxIterations;
+    return true;
+}
+
+WasatchVCPP::BaselineRemover::Method WasatchVCPP::BaselineRemover::getMethod()
+{
+    return method;
+}
+
+//! Subtract the baseline from a spectrum in-place.
+template<typename T>
+void WasatchVCPP::BaselineRemover::apply(T* spectrum, int pixels)
+{
+    if (method == METHOD_NONE || pixels < 3)
+        return;
+
+    resize(pixels);
+    for (int i = 0; i < pixels; i++)
+        y[i] = spectrum[i];
+
+    if (method == METHOD_ALS)
+        fitALS();
+    else
+        fitAirPLS();
+
+    for (int i = 0; i < pixels; i++)
+        spectrum[i] = (T)(y[i] - z[i]);
+}
+
+//! (re)build the penalty diagonals whenever the spectrum length changes
+void WasatchVCPP::BaselineRemover::resize(int pixels)
+{
+    if ((int)y.size() == pixels)
+        return;
+
+    y.resize(pixels);
+    z.resize(pixels);
+    w.resize(pixels);
+    d.resize(pixels);
+    e.resize(pixels);
+    f.resize(pixels);
+
+    // accumulate D2'D2 row by row of D2 (each row is [1, -2, 1])
+    p0.assign(pixels, 0);
+    p1.assign(pixels, 0);
+    p2.assign(pixels, 0);
+    for (int r = 0; r + 2 < pixels; r++)
+    {
+        p0[r]     += 1;
+        p0[r + 1] += 4;
+        p0[r + 2] += 1;
+        p1[r]     -= 2;
+        p1[r + 1] -= 2;
+        p2[r]     += 1;
+    }
+}
+
+//! Solve (W + lambda * D2'D2) z = W y.
+//!
+//! The LDL' factorization and forward substitution share one pass, with
+//! back substitution in a second.  A[i][i] is w[i] + lambda * p0[i],
+//! A[i+1][i] is lambda * p1[i] and A[i+2][i] is lambda * p2[i]; L has unit
+//! diagonal, L[i+1][i] = e[i] and L[i+2][i] = f[i].
+void WasatchVCPP::BaselineRemover::solve()
+{
+    const int n = (int)y.size();
+    double* u = z.data(); // forward-substituted intermediate, overwritten below
+
+    for (int i = 0; i < n; i++)
+    {
+        double di = w[i] + lambda * p0[i];
+        double ui = w[i] * y[i];
+        if (i >= 1)
+        {
+            di -= e[i - 1] * e[i - 1] * d[i - 1];
+            ui -= e[i - 1] * u[i - 1];
+        }
+        if (i >= 2)
+        {
+            di -= f[i - 2] * f[i - 2] * d[i - 2];
+            ui -= f[i - 2] * u[i - 2];
+        }
+
+        d[i] = di;
+        u[i] = ui;
+        e[i] = lambda * p1[i];
+        if (i >= 1)
+            e[i] -= f[i - 1] * d[i - 1] * e[i - 1];
+        e[i] /= di;
+        f[i] = lambda * p2[i] / di;
+    }
+
+    for (int i = n - 1; i >= 0; i--)
+    {
+        double zi = u[i] / d[i];
+        if (i + 1 < n)
+            zi -= e[i] * z[i + 1];
+        if (i + 2 < n)
+            zi -= f[i] * z[i + 2];
+        z[i] = zi;
+    }
+}
+
+//! asymmetric least squares: iterate until no weight changes
+void WasatchVCPP::BaselineRemover::fitALS()
+{
+    const int n = (int)y.size();
+    std::fill(w.begin(), w.end(), 1.0);
+    for (int iter = 0; iter < maxIterations; iter++)
+    {
+        solve();
+
+        bool changed = false;
+        for (int i = 0; i < n; i++)
+        {
+            double weight = y[i] > z[i] ? p : 1 - p;
+            changed |= weight != w[i];
+            w[i] = weight;
+        }
+        if (!changed)
+            break;
+    }
+}
+
+//! adaptive iteratively reweighted penalized least squares: iterate until the
+//! points below the baseline sum to under 0.1% of the spectrum
+void WasatchVCPP::BaselineRemover::fitAirPLS()
+{
+    const int n = (int)y.size();
+
+    double total = 0;
+    for (int i = 0; i < n; i++)
+        total += fabs(y[i]);
+
+    std::fill(w.begin(), w.end(), 1.0);
+    for (int iter = 1; iter <= maxIterations; iter++)
+    {
+        solve();
+
+        double below = 0;
+        double shallowest = -HUGE_VAL;
+        for (int i = 0; i < n; i++)
+        {
+            double residual = y[i] - z[i];
+            if (residual < 0)
+            {
+                below -= residual;
+                shallowest = std::max(shallowest, residual);
+            }
+        }
+        if (below <= 0.001 * total)
+            break;
+
+        for (int i = 0; i < n; i++)
+        {
+            double residual = y[i] - z[i];
+            w[i] = residual >= 0 ? 0 : exp(iter * -residual / below);
+        }
+
+        // keep the ends weighted, so the system stays positive-definite
+        w[0] = w[n - 1] = exp(iter * shallowest / below);
+    }
+}
+
+// instantiate for ProcessingPipeline::process
+template void WasatchVCPP::BaselineRemover::apply<double>(double* spectrum, int pixels);
+template void WasatchVCPP::BaselineRemover::apply<float>(float* spectrum, int pixels);
@@ -0,0 +1,62 @@
+/**
+    @file   BaselineRemover.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::BaselineRemover
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <vector>
+
+namespace WasatchVCPP
+{
+    //! Internal class subtracting a smooth, asymmetrically-weighted baseline
+    //! (typically fluorescence) from each spectrum.
+    //!
+    //! The baseline z minimizes sum(w * (y - z)^2) + lambda * sum((D2 z)^2),
+    //! where D2 is the second-difference operator.  ALS (Eilers & Boelens)
+    //! weights points above the baseline by p and those below by 1 - p;
+    //! airPLS (Zhang et al.) weights points above by zero and those below
+    //! exponentially by their depth.  Either way the weights are refined
+    //! over a few iterations.
+    //!
+    //! W + lambda * D2'D2 is symmetric and pentadiagonal, so each iteration
+    //! is a banded LDL' factorization and solve in O(pixels).  All workspace
+    //! is retained between spectra.
+    //!
+    //! Not internally synchronized (ProcessingPipeline serializes access).
+    class BaselineRemover
+    {
+        public:
+            enum Method
+            {
+                METHOD_NONE,
+                METHOD_ALS,
+                METHOD_AIRPLS
+            };
+
+            bool configure(Method method, double lambda, double p, int maxIterations);
+            Method getMethod();
+
+            template<typename T> void apply(T* spectrum, int pixels);
+
+        private:
+            Method method = METHOD_NONE;
+            double lambda = 1e5;            //!< smoothness
+            double p = 0.01;                //!< ALS asymmetry
+            int maxIterations = 10;
+
+            // workspace (sized to the spectrum)
+            std::vector<double> y;          //!< input spectrum
+            std::vector<double> z;          //!< baseline
+            std::vector<double> w;          //!< weights
+            std::vector<double> p0, p1, p2; //!< main, first and second diagonals of D2'D2
+            std::vector<double> d, e, f;    //!< LDL' factors (d diagonal, e and f subdiagonals of L)
+
+            void resize(int pixels);
+            void solve();
+            void fitALS();
+            void fitAirPLS();
+    };
+}
@@ -8,11 +8,16 @@
 
 #include "Driver.h"
 #include "Spectrometer.h"
+#include "UsbTransport.h"
+#include "SimulatedDevice.h"
+#include "SessionRecorder.h"
+#include "ReplayTransport.h"
 #include "Util.h"
 
 #include <stdio.h>
 #include <string>
 #include <iostream>
+#include <thread>
 
 using std::mutex;
 using std::vector;
@@ -77,6 +82,24 @@ int WasatchVCPP::Driver::openAllSpectrometers()
 
     spectrometers.clear();
 
+    if (!openUsbSpectrometers() && simulatedConfig.count == 0)
+    {
+        mutSpectrometers.unlock();
+        return -1;
+    }
+    openSimulatedSpectrometers();
+
+    mutSpectrometers.unlock();
+
+    logger.info("Driver::openAllSpectrometers: done");
+    return (int)spectrometers.size();
+}
+
+//! Open every supported USB spectrometer (caller holds mutSpectrometers).
+//!
+//! @returns false if USB devices could not be enumerated
+bool WasatchVCPP::Driver::openUsbSpectrometers()
+{
 #ifdef USE_LIBUSB_WIN32
     usb_init();
     usb_find_busses();
@@ -119,8 +142,9 @@ int WasatchVCPP::Driver::openAllSpectrometers()
                             }
 
                             int index = (int)spectrometers.size();
-                            auto spec = new Spectrometer(udev, pid, index, logger);
-                            logger.debug("adding Spectrometer as index %d", index);
+                            auto spec = new Spectrometer(new UsbTransport(udev, logger), pid, index, logger, createRecorder(index, pid));
+                            spec->bus = (int)bus->location;
+                            logger.debug("adding Spectrometer as index %d (bus %d)", index, spec->bus);
 
                             spectrometers.insert(make_pair(index, spec));
                         }
@@ -144,7 +168,7 @@ int WasatchVCPP::Driver::openAllSpectrometers()
     if (r < 0) 
     {
         logger.error("Failed to init USB");
-        return -1;
+        return false;
     }
 
     ssize_t cnt = libusb_get_device_list(nullptr, &devs);
@@ -152,7 +176,7 @@ int WasatchVCPP::Driver::openAllSpectrometers()
     {
         logger.debug("Failed to get USB device list");
         libusb_exit(nullptr);
-        return int(cnt);
+        return false;
     }
 
     libusb_device *dev = nullptr;
@@ -164,7 +188,8 @@ int WasatchVCPP::Driver::openAllSpectrometers()
         int r = libusb_get_device_descriptor(dev, &desc);
         if (r < 0) {
             logger.debug("Failed to get device descriptor");
-            return -1;
+            libusb_free_device_list(devs, 1);
+            return false;
         }
 
         logger.debug("discovered 0x%04x:0x%04x", desc.idVendor, desc.idProduct);
@@ -200,8 +225,9 @@ int WasatchVCPP::Driver::openAllSpectrometers()
                         }
 
                         int index = (int)spectrometers.size();
-                        auto spec = new Spectrometer(udev, pid, index, logger);
-                        logger.debug("adding Spectrometer as index %d", index);
+                        auto spec = new Spectrometer(new UsbTransport(udev, logger), pid, index, logger, createRecorder(index, pid));
+                        spec->bus = libusb_get_bus_number(dev);
+                        logger.debug("adding Spectrometer as index %d (bus %d)", index, spec->bus);
 
                         spectrometers.insert(make_pair(index, spec));
                     }
@@ -220,10 +246,74 @@ int WasatchVCPP::Driver::openAllSpectrometers()
     libusb_free_device_list(devs, 1);
 #endif
 
+    return true;
+}
+
+//! Append any simulated spectrometers requested by setSimulatedSpectrometers
+//! (caller holds mutSpectrometers).
+void WasatchVCPP::Driver::openSimulatedSpectrometers()
+{
+    for (int i = 0; i < simulatedConfig.count; i++)
+    {
+        SimulatedDevice::Config config;
+        config.pid = 0x1000;
+        config.latencyScale = simulatedConfig.latencyScale;
+        config.seed = i;
+        config.eepromPages = simulatedConfig.eepromPages;
+        if (config.eepromPages.empty())
+            config.eepromPages = SimulatedDevice::defaultEEPROM(Util::sprintf("SIM-%04d", i), simulatedConfig.pixels);
+
+        int index = (int)spectrometers.size();
+        auto spec = new Spectrometer(new SimulatedDevice(config, logger), config.pid, index, logger, createRecorder(index, config.pid));
+        logger.debug("adding simulated Spectrometer as index %d", index);
+
+        spectrometers.insert(make_pair(index, spec));
+    }
+}
+
+//! @returns a SessionRecorder for the spectrometer about to be opened as 
+//!          index, if setCapturePrefix is in effect and its file could be 
+//!          created (caller holds mutSpectrometers)
+WasatchVCPP::SessionRecorder* WasatchVCPP::Driver::createRecorder(int index, int pid)
+{
+    if (capturePrefix.empty())
+        return nullptr;
+
+    auto recorder = new SessionRecorder(logger);
+    if (!recorder->open(capturePrefix + Util::sprintf("%d.wpcap", index), pid))
+    {
+        delete recorder;
+        return nullptr;
+    }
+    return recorder;
+}
+
+//! Open a spectrometer replaying a session captured through setCapturePrefix,
+//! after any already open.
+//!
+//! @param pathname (Input) a capture file
+//! @param realTime (Input) reproduce the recorded timing (else run as fast
+//!        as possible)
+//! @returns the new spectrometer's index, or -1 if the capture couldn't be read
+int WasatchVCPP::Driver::openReplay(const string& pathname, bool realTime)
+{
+    logger.info("Driver::openReplay(%s)", pathname.c_str());
+
+    auto transport = new ReplayTransport(realTime, logger);
+    if (!transport->load(pathname))
+    {
+        delete transport;
+        return -1;
+    }
+
+    mutSpectrometers.lock();
+    int index = spectrometers.empty() ? 0 : spectrometers.rbegin()->first + 1;
+    auto spec = new Spectrometer(transport, transport->getPID(), index, logger);
+    logger.debug("adding replayed Spectrometer as index %d", index);
+    spectrometers.insert(make_pair(index, spec));
     mutSpectrometers.unlock();
 
-    logger.info("Driver::openAllSpectrometers: done");
-    return (int)spectrometers.size();
+    return index;
 }
 
 WasatchVCPP::Spectrometer* WasatchVCPP::Driver::getSpectrometer(int index)
@@ -253,6 +343,7 @@ bool WasatchVCPP::Driver::removeSpectrometer(int index)
 
     // release resources
     bool ok = spec->close();
+    closedUsbStats[spec->bus].add(spec->getUsbStats());
     delete spec;
     spec = nullptr;
 
@@ -279,3 +370,132 @@ bool WasatchVCPP::Driver::closeAllSpectrometers()
 
 string WasatchVCPP::Driver::getLibraryVersion() { return libraryVersion; }
 
+//! Takes effect at the next openAllSpectrometers.
+void WasatchVCPP::Driver::setSimulatedSpectrometers(const SimulatedConfig& config)
+{
+    mutSpectrometers.lock();
+    simulatedConfig = config;
+    mutSpectrometers.unlock();
+}
+
+WasatchVCPP::SimulatedConfig WasatchVCPP::Driver::getSimulatedSpectrometers()
+{
+    mutSpectrometers.lock();
+    SimulatedConfig config = simulatedConfig;
+    mutSpectrometers.unlock();
+    return config;
+}
+
+//! Capture each spectrometer opened by the next openAllSpectrometers to 
+//! "<prefix><index>.wpcap" (see SessionRecorder), from its first transfer 
+//! until it is closed.
+//!
+//! @param prefix (Input) path prefix, or empty to stop capturing new spectrometers
+void WasatchVCPP::Driver::setCapturePrefix(const string& prefix)
+{
+    mutSpectrometers.lock();
+    capturePrefix = prefix;
+    mutSpectrometers.unlock();
+}
+
+//! Sum the USB counters of every spectrometer on a bus, including those
+//! since closed, so that bus totals never go backwards.
+//!
+//! @param bus (Input) USB bus number (see Spectrometer::bus)
+//! @param stats (Output) totals for the bus
+//! @returns false if no spectrometer has been opened on that bus
+bool WasatchVCPP::Driver::getBusUsbStats(int bus, UsbStats& stats)
+{
+    stats = UsbStats();
+    bool found = false;
+
+    mutSpectrometers.lock();
+    auto closed = closedUsbStats.find(bus);
+    if (closed != closedUsbStats.end())
+    {
+        stats.add(closed->second);
+        found = true;
+    }
+    for (auto i = spectrometers.begin(); i != spectrometers.end(); i++)
+    {
+        if (i->second->bus == bus)
+        {
+            stats.add(i->second->getUsbStats());
+            found = true;
+        }
+    }
+    mutSpectrometers.unlock();
+
+    return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Multi-Channel Acquisition
+////////////////////////////////////////////////////////////////////////////////
+
+//! Trigger spectrometers 0 to count-1 back-to-back, then read all their 
+//! spectra in parallel, so that the set is as nearly simultaneous as software
+//! triggering allows.
+//!
+//! @param spectra (Output) spectra[i] receives the spectrum of specIndex i
+//! @param lens (Input) allocated length of each spectra[i]
+//! @param triggerTimestampsUS (Output) when each spectrometer's ACQUIRE was 
+//!        sent (Util::timestampUS), or 0 if it could not be triggered
+//! @param count (Input) number of spectrometers
+//! @returns true if every spectrometer returned a spectrum
+bool WasatchVCPP::Driver::acquireAll(double** spectra, const int* lens, long long* triggerTimestampsUS, int count)
+{
+    vector<Spectrometer*> specs(count, nullptr);
+    for (int i = 0; i < count; i++)
+    {
+        triggerTimestampsUS[i] = 0;
+
+        auto spec = getSpectrometer(i);
+        if (spec == nullptr)
+            continue;
+
+        if (spectra[i] == nullptr || lens[i] < spec->getSpectrumLength())
+        {
+            logger.error("Driver::acquireAll: insufficient storage for spectrometer %d", i);
+            continue;
+        }
+
+        if (spec->isContinuous())
+        {
+            logger.error("Driver::acquireAll: spectrometer %d is in continuous acquisition", i);
+            continue;
+        }
+
+        specs[i] = spec;
+    }
+
+    // fire all triggers first, with nothing in between
+    for (int i = 0; i < count; i++)
+        if (specs[i] != nullptr)
+        {
+            if (specs[i]->sendSoftwareTrigger())
+                triggerTimestampsUS[i] = specs[i]->getLastTriggerTimestampUS();
+            else
+                specs[i] = nullptr;
+        }
+
+    // then collect the spectra concurrently
+    vector<char> ok(count, 0);
+    vector<std::thread> readers;
+    for (int i = 0; i < count; i++)
+        if (specs[i] != nullptr)
+            readers.push_back(std::thread([&, i] { ok[i] = specs[i]->getSpectrum(spectra[i], lens[i], false); }));
+
+    for (auto& reader : readers)
+        reader.join();
+
+    bool allOk = true;
+    for (int i = 0; i < count; i++)
+        if (!ok[i])
+        {
+            logger.error("Driver::acquireAll: no spectrum from spectrometer %d", i);
+            allOk = false;
+        }
+    return allOk;
+}
+
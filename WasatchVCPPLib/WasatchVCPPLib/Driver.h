@@ -15,8 +15,10 @@
 #endif
 
 #include "Logger.h"
+#include "UsbStats.h"
 
 #include <string>
+#include <vector>
 #include <mutex>
 #include <map>
 
@@ -25,6 +27,17 @@
 namespace WasatchVCPP
 {
     class Spectrometer;
+    class SessionRecorder;
+
+    //! Simulated spectrometers to be opened (after any real ones) by 
+    //! Driver::openAllSpectrometers.
+    struct SimulatedConfig
+    {
+        int count = 0;
+        int pixels = 1024;              //!< for the default EEPROM
+        double latencyScale = 1.0;      //!< see SimulatedDevice::Config
+        std::vector<std::vector<uint8_t> > eepromPages; //!< empty for SimulatedDevice::defaultEEPROM
+    };
 
     /**
         @brief  This is an internal class encapsulating state and control of all
@@ -75,6 +88,16 @@ namespace WasatchVCPP
             Spectrometer* getSpectrometer(int index);
             bool removeSpectrometer(int index);
 
+            bool acquireAll(double** spectra, const int* lens, long long* triggerTimestampsUS, int count);
+
+            bool getBusUsbStats(int bus, UsbStats& stats);
+
+            void setSimulatedSpectrometers(const SimulatedConfig& config);
+            SimulatedConfig getSimulatedSpectrometers();
+
+            void setCapturePrefix(const std::string& prefix);
+            int openReplay(const std::string& pathname, bool realTime);
+
             std::string getLibraryVersion();
 
             Logger logger;
@@ -86,6 +109,13 @@ namespace WasatchVCPP
 
             Driver(); 
 
+            bool openUsbSpectrometers();
+            void openSimulatedSpectrometers();
+            SessionRecorder* createRecorder(int index, int pid);
+
             std::map<int, Spectrometer*> spectrometers;
+            std::map<int, UsbStats> closedUsbStats; //!< by bus, of spectrometers since removed
+            SimulatedConfig simulatedConfig;        //!< guarded by mutSpectrometers
+            std::string capturePrefix;              //!< guarded by mutSpectrometers (empty if not capturing)
     };
 }
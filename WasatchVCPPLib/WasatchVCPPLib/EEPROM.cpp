@@ -129,6 +129,7 @@ bool WasatchVCPP::EEPROM::parse(const vector<vector<uint8_t> >& pages_in)
     badPixelsVector.clear();
     for (auto pixel : badPixelsSet)
         badPixelsVector.push_back(pixel); // cache sorted enumerable list
+    compileBadPixelRuns(activePixelsHoriz);
 
     if (format >= 5)
         productConfiguration = ParseData::toString(pages[5], 30, 16);
@@ -177,6 +178,38 @@ bool WasatchVCPP::EEPROM::parse(const vector<vector<uint8_t> >& pages_in)
 
 inline const char* toBool(bool b) { return b ? "true" : "false"; }
 
+//! Precompile badPixelsSet into the runs applied by
+//! Spectrometer::correctBadPixels, so that per-spectrum correction needn't
+//! search for each bad pixel's good neighbors.
+//!
+//! Bad pixels beyond the detector are ignored, as is the degenerate case of
+//! every pixel being bad.
+void WasatchVCPP::EEPROM::compileBadPixelRuns(int pixels)
+{
+    badPixelRuns.clear();
+
+    auto it = badPixelsSet.begin();
+    while (it != badPixelsSet.end() && *it < pixels)
+    {
+        int first = *it;
+        int last = first;
+        while (++it != badPixelsSet.end() && *it == last + 1 && *it < pixels)
+            last++;
+
+        int prevGood = first - 1;
+        int nextGood = last + 1;
+        if (prevGood < 0 && nextGood >= pixels)
+            continue;
+
+        BadPixelRun run;
+        run.prevGood = (int16_t)(prevGood >= 0 ? prevGood : nextGood);    // left edge: copy leftward
+        run.nextGood = (int16_t)(nextGood < pixels ? nextGood : prevGood); // right edge: copy rightward
+        run.start = (int16_t)first;
+        run.span = (int16_t)(last - first + 2);
+        badPixelRuns.push_back(run);
+    }
+}
+
 void WasatchVCPP::EEPROM::stringify(const string& name, const string& value)
 {
     stringified.insert(make_pair(name, value));
@@ -35,6 +35,18 @@ namespace WasatchVCPP
                 SUBFORMAT_COUNT = 3
             };
 
+            //! A contiguous run of bad pixels, and the good pixels on either
+            //! side to interpolate between.  At the detector edges, where only
+            //! one good neighbor exists, prevGood == nextGood so the run is
+            //! simply filled with that neighbor's value.
+            struct BadPixelRun
+            {
+                int16_t prevGood;   //!< good pixel interpolated from
+                int16_t nextGood;   //!< good pixel interpolated to
+                int16_t start;      //!< first bad pixel in the run
+                int16_t span;       //!< interpolation denominator (bad pixels in run + 1)
+            };
+
             ////////////////////////////////////////////////////////////////////
             // Constants
             ////////////////////////////////////////////////////////////////////
@@ -50,6 +62,7 @@ namespace WasatchVCPP
 
             bool parse(const std::vector<std::vector<uint8_t> >& pages);
             bool has_srm();
+            void compileBadPixelRuns(int pixels);
 
             void stringifyAll();
             void stringify(const std::string& name, const std::string& value);
@@ -119,6 +132,7 @@ namespace WasatchVCPP
             // it's convenient to have both, and faster to cache
             std::set<int16_t> badPixelsSet;
             std::vector<int16_t> badPixelsVector;
+            std::vector<BadPixelRun> badPixelRuns; //!< precompiled from badPixelsSet
 
             std::string productConfiguration;
 
@@ -0,0 +1,229 @@
+/**
+    @file   LatencyStats.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::LatencyHistogram and LatencyStats
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "LatencyStats.h"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using std::vector;
+
+//! @returns floor(log2(value)) for value > 0
+static int log2Floor(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long bit = 0;
+    _BitScanReverse64(&bit, value);
+    return (int)bit;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LatencyHistogram
+////////////////////////////////////////////////////////////////////////////////
+
+WasatchVCPP::LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void WasatchVCPP::LatencyHistogram::reset()
+{
+    for (int i = 0; i < BUCKETS; i++)
+        counts[i].store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    totalNS.store(0, std::memory_order_relaxed);
+    maxNS.store(0, std::memory_order_relaxed);
+}
+
+//! Values below SUB_BUCKETS get a bucket each; above that, the top 
+//! SUB_BUCKET_BITS + 1 significant bits select the bucket.
+int WasatchVCPP::LatencyHistogram::bucketIndex(uint64_t ns)
+{
+    if (ns < (uint64_t)SUB_BUCKETS)
+        return (int)ns;
+
+    int exponent = log2Floor(ns);
+    int sub = (int)(ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    int index = (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    return std::min(index, BUCKETS - 1);
+}
+
+//! @returns the center of the values mapped to a bucket
+uint64_t WasatchVCPP::LatencyHistogram::bucketMidpoint(int index)
+{
+    if (index < SUB_BUCKETS)
+        return (uint64_t)index;
+
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t sub = (uint64_t)(index % SUB_BUCKETS);
+    uint64_t width = (uint64_t)1 << (exponent - SUB_BUCKET_BITS);
+    return ((SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS)) + width / 2;
+}
+
+void WasatchVCPP::LatencyHistogram::record(uint64_t ns)
+{
+    counts[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    totalNS.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t prev = maxNS.load(std::memory_order_relaxed);
+    while (ns > prev && !maxNS.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+        ;
+}
+
+uint64_t WasatchVCPP::LatencyHistogram::getCount() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t WasatchVCPP::LatencyHistogram::getMaxNS() const
+{
+    return maxNS.load(std::memory_order_relaxed);
+}
+
+double WasatchVCPP::LatencyHistogram::getMeanNS() const
+{
+    uint64_t n = getCount();
+    return n ? (double)totalNS.load(std::memory_order_relaxed) / n : 0;
+}
+
+//! @param q (Input) quantile in (0, 1] (e.g. 0.99 for p99)
+//! @returns the midpoint of the bucket holding that rank (never above the
+//!          recorded maximum), or 0 if empty
+double WasatchVCPP::LatencyHistogram::getPercentileNS(double q) const
+{
+    // sum the buckets rather than trusting 'count', in case a record() is
+    // in flight
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; i++)
+        total += counts[i].load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)ceil(q * total);
+    rank = std::max((uint64_t)1, std::min(rank, total));
+
+    uint64_t seen = 0;
+    int i = 0;
+    for ( ; i < BUCKETS - 1; i++)
+    {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            break;
+    }
+
+    return (double)std::min(bucketMidpoint(i), getMaxNS());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LatencyStats
+////////////////////////////////////////////////////////////////////////////////
+
+WasatchVCPP::LatencyStats::LatencyStats()
+{
+    enabled.store(false);
+    for (int i = 0; i < KEYS; i++)
+        histograms[i].store(nullptr);
+}
+
+WasatchVCPP::LatencyStats::~LatencyStats()
+{
+    for (int i = 0; i < KEYS; i++)
+        delete histograms[i].load();
+}
+
+void WasatchVCPP::LatencyStats::setEnabled(bool flag)
+{
+    enabled.store(flag, std::memory_order_relaxed);
+}
+
+bool WasatchVCPP::LatencyStats::isEnabled() const
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t WasatchVCPP::LatencyStats::nowNS()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//! @returns a start time to pass to end(), or 0 if disabled
+uint64_t WasatchVCPP::LatencyStats::begin() const
+{
+    return isEnabled() ? nowNS() : 0;
+}
+
+//! Record the time elapsed since begin() under the given key.
+//!
+//! Does nothing if recording was disabled at begin() (start == 0).
+void WasatchVCPP::LatencyStats::end(int key, uint64_t start)
+{
+    if (start == 0 || key < 0 || key >= KEYS)
+        return;
+
+    uint64_t elapsed = nowNS() - start;
+
+    LatencyHistogram* h = histograms[key].load(std::memory_order_acquire);
+    if (h == nullptr)
+    {
+        // first use: whichever thread loses the race discards its copy
+        LatencyHistogram* fresh = new LatencyHistogram();
+        if (histograms[key].compare_exchange_strong(h, fresh, std::memory_order_acq_rel))
+            h = fresh;
+        else
+            delete fresh;
+    }
+    h->record(elapsed);
+}
+
+int WasatchVCPP::LatencyStats::controlKey(uint8_t bRequest, uint16_t wValue)
+{
+    return bRequest == 0xff ? SECOND_TIER + (wValue & 0xff) : bRequest;
+}
+
+//! Zero all histograms (they remain allocated).
+void WasatchVCPP::LatencyStats::reset()
+{
+    for (int i = 0; i < KEYS; i++)
+    {
+        LatencyHistogram* h = histograms[i].load(std::memory_order_acquire);
+        if (h != nullptr)
+            h->reset();
+    }
+}
+
+//! @returns a summary of each key recorded since the last reset, in key order
+vector<WasatchVCPP::LatencyStats::Summary> WasatchVCPP::LatencyStats::summarize() const
+{
+    vector<Summary> summaries;
+    for (int i = 0; i < KEYS; i++)
+    {
+        const LatencyHistogram* h = histograms[i].load(std::memory_order_acquire);
+        if (h == nullptr || h->getCount() == 0)
+            continue;
+
+        Summary s;
+        s.key = i;
+        s.count = h->getCount();
+        s.meanUS = h->getMeanNS() / 1000;
+        s.p50US = h->getPercentileNS(0.50) / 1000;
+        s.p99US = h->getPercentileNS(0.99) / 1000;
+        s.maxUS = (double)h->getMaxNS() / 1000;
+        summaries.push_back(s);
+    }
+    return summaries;
+}
@@ -0,0 +1,101 @@
+/**
+    @file   LatencyStats.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::LatencyHistogram and LatencyStats
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+namespace WasatchVCPP
+{
+    //! Internal lock-free histogram of durations in nanoseconds.
+    //!
+    //! Buckets are laid out HDR-style: each power-of-two range ("octave") is
+    //! split into 16 equal sub-buckets, so any reported quantile is within
+    //! 1/32 (about 3%) of a recorded value, from nanoseconds to days, in a
+    //! fixed 6KB of counters.  Recording is a handful of relaxed atomic 
+    //! increments; readers may see a recording in progress (e.g. the count
+    //! bumped but not yet the bucket), which is harmless for statistics.
+    class LatencyHistogram
+    {
+        public:
+            static const int SUB_BUCKET_BITS = 4;
+            static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+            static const int MAX_EXPONENT = 48;     //!< ~3 days in ns
+            static const int BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+            LatencyHistogram();
+
+            void record(uint64_t ns);
+            void reset();
+
+            uint64_t getCount() const;
+            uint64_t getMaxNS() const;
+            double getMeanNS() const;
+            double getPercentileNS(double q) const;
+
+            static int bucketIndex(uint64_t ns);
+            static uint64_t bucketMidpoint(int index);
+
+        private:
+            std::atomic<uint64_t> counts[BUCKETS];
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> totalNS;
+            std::atomic<uint64_t> maxNS;
+    };
+
+    //! Internal collection of LatencyHistograms for one Spectrometer, keyed
+    //! by USB operation.
+    //!
+    //! Control transfers are keyed by bRequest, except second-tier opcodes 
+    //! (bRequest 0xff), which are keyed by their wValue; bulk reads are keyed
+    //! by endpoint.  Histograms are allocated on first use (lock-free) and 
+    //! live until the Spectrometer is destroyed, so summarize() and reset()
+    //! may run concurrently with recording.
+    //!
+    //! Disabled by default, in which case begin() / end() cost one relaxed 
+    //! load.  Enabled, they add two steady_clock reads and the histogram's 
+    //! atomic increments (around 100ns all told).
+    class LatencyStats
+    {
+        public:
+            static const int SECOND_TIER = 0x100;   //!< + wValue of bRequest 0xff
+            static const int BULK = 0x200;          //!< + endpoint
+            static const int KEYS = 0x300;
+
+            struct Summary
+            {
+                int key;
+                uint64_t count;
+                double meanUS;
+                double p50US;
+                double p99US;
+                double maxUS;
+            };
+
+            LatencyStats();
+            ~LatencyStats();
+
+            void setEnabled(bool flag);
+            bool isEnabled() const;
+
+            uint64_t begin() const;
+            void end(int key, uint64_t start);
+
+            static int controlKey(uint8_t bRequest, uint16_t wValue);
+
+            void reset();
+            std::vector<Summary> summarize() const;
+
+        private:
+            std::atomic<bool> enabled;
+            std::atomic<LatencyHistogram*> histograms[KEYS];
+
+            static uint64_t nowNS();
+    };
+}
@@ -70,6 +70,8 @@ void WasatchVCPP::Logger::output(const string& lvlName, const string& msg)
 {
     string line = Util::sprintf("%s [%s] %s\r\n", Util::timestamp().c_str(), lvlName.c_str(), msg.c_str());
 
+    std::lock_guard<std::mutex> lock(mutOutput);
+
 #if _WINDOWS
     OutputDebugStringA(line.c_str());
 #endif
@@ -10,6 +10,7 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <mutex>
 
 namespace WasatchVCPP
 {
@@ -37,6 +38,7 @@ namespace WasatchVCPP
         private:
             void output(const std::string& lvlName, const std::string& msg);
             std::ofstream logfile;
+            std::mutex mutOutput; //!< may be called from background threads
     };
 }
 
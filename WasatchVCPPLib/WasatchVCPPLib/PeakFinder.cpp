@@ -0,0 +1,146 @@
+/**
+    @file   PeakFinder.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::PeakFinder
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "PeakFinder.h"
+
+#include <cmath>
+#include <algorithm>
+
+using std::vector;
+using std::mutex;
+using std::lock_guard;
+using std::max;
+using std::min;
+
+//! Find peaks in a spectrum.
+//!
+//! @param spectrum (Input) intensities
+//! @param len (Input) length of spectrum
+//! @param params (Input) constraints on reported peaks
+//! @param maxPeaks (Input) report at most this many (the most prominent)
+//! @param peaks (Output) reported peaks, in order of position
+//! @returns number of peaks reported
+int WasatchVCPP::PeakFinder::find(const double* spectrum, int len, const Params& params, int maxPeaks, vector<Peak>& peaks)
+{
+    peaks.clear();
+    if (spectrum == nullptr || len < 3 || maxPeaks < 1)
+        return 0;
+
+    lock_guard<mutex> lock(mutScratch);
+
+    // flag local maxima (taking the left edge of any plateau); the loop is
+    // branch-free so that the compiler can vectorize it
+    isMax.resize(len);
+    isMax[0] = isMax[len - 1] = 0;
+    for (int i = 1; i < len - 1; i++)
+        isMax[i] = (spectrum[i] > spectrum[i - 1]) & (spectrum[i] >= spectrum[i + 1]);
+
+    candidates.clear();
+    for (int i = 1; i < len - 1; i++)
+        if (isMax[i] && (params.minHeight == 0 || spectrum[i] >= params.minHeight))
+            candidates.push_back(i);
+
+    // enforce minimum distance, letting taller peaks suppress shorter ones
+    if (params.minDistance > 0 && candidates.size() > 1)
+    {
+        vector<int> byHeight(candidates);
+        std::stable_sort(byHeight.begin(), byHeight.end(),
+            [spectrum](int a, int b) { return spectrum[a] > spectrum[b]; });
+        for (int i : byHeight)
+        {
+            if (!isMax[i])
+                continue;
+            for (int j = max(0, i - params.minDistance); j <= min(len - 1, i + params.minDistance); j++)
+                if (j != i)
+                    isMax[j] = 0;
+        }
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+            [this](int i) { return !isMax[i]; }), candidates.end());
+    }
+
+    for (int i : candidates)
+    {
+        const double apex = spectrum[i];
+
+        // walk each way until something taller, tracking the lowest point
+        int left = i;
+        double leftMin = apex;
+        for (int j = i - 1; j >= 0 && spectrum[j] <= apex; j--)
+            if (spectrum[j] < leftMin)
+            {
+                leftMin = spectrum[j];
+                left = j;
+            }
+
+        int right = i;
+        double rightMin = apex;
+        for (int j = i + 1; j < len && spectrum[j] <= apex; j++)
+            if (spectrum[j] < rightMin)
+            {
+                rightMin = spectrum[j];
+                right = j;
+            }
+
+        double prominence = apex - max(leftMin, rightMin);
+        if (prominence <= 0 || prominence < params.minProminence)
+            continue;
+
+        // interpolated crossings of the half-prominence line
+        double halfHeight = apex - prominence / 2;
+
+        int j = i;
+        while (j > left && spectrum[j] > halfHeight)
+            j--;
+        double xLeft = spectrum[j] < halfHeight
+                     ? j + (halfHeight - spectrum[j]) / (spectrum[j + 1] - spectrum[j])
+                     : j;
+
+        j = i;
+        while (j < right && spectrum[j] > halfHeight)
+            j++;
+        double xRight = spectrum[j] < halfHeight
+                      ? j - (halfHeight - spectrum[j]) / (spectrum[j - 1] - spectrum[j])
+                      : j;
+
+        double width = xRight - xLeft;
+        if (width < params.minWidth || (params.maxWidth > 0 && width > params.maxWidth))
+            continue;
+
+        // intensity-weighted centroid of the pixels above the line
+        double sum = 0;
+        double weighted = 0;
+        for (int k = (int)ceil(xLeft); k <= (int)floor(xRight); k++)
+        {
+            double w = spectrum[k] - halfHeight;
+            if (w > 0)
+            {
+                sum += w;
+                weighted += w * k;
+            }
+        }
+
+        Peak peak;
+        peak.pixel = sum > 0 ? weighted / sum : i;
+        peak.intensity = apex;
+        peak.prominence = prominence;
+        peak.width = width;
+        peaks.push_back(peak);
+    }
+
+    // keep the most prominent, reported in order of position
+    if ((int)peaks.size() > maxPeaks)
+    {
+        std::stable_sort(peaks.begin(), peaks.end(),
+            [](const Peak& a, const Peak& b) { return a.prominence > b.prominence; });
+        peaks.resize(maxPeaks);
+        std::sort(peaks.begin(), peaks.end(),
+            [](const Peak& a, const Peak& b) { return a.pixel < b.pixel; });
+    }
+
+    return (int)peaks.size();
+}
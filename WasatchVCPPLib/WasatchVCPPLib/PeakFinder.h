@@ -0,0 +1,57 @@
+/**
+    @file   PeakFinder.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::PeakFinder
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+namespace WasatchVCPP
+{
+    //! Internal class locating peaks within a spectrum.
+    //!
+    //! Peaks are characterized as in scipy.signal.find_peaks: a peak's
+    //! prominence is its height above the higher of the two lowest points
+    //! reached before climbing to anything taller on either side, and its
+    //! width is measured at half that prominence.  Each peak's position is
+    //! then refined to the intensity-weighted centroid of the pixels above
+    //! that half-prominence line.
+    //!
+    //! Each Spectrometer owns one, so that scratch buffers are reused across
+    //! spectra.
+    class PeakFinder
+    {
+        public:
+            //! constraints on reported peaks (zero disables each)
+            struct Params
+            {
+                double minHeight = 0;       //!< minimum intensity at the apex
+                double minProminence = 0;   //!< minimum prominence
+                double minWidth = 0;        //!< minimum width in pixels
+                double maxWidth = 0;        //!< maximum width in pixels
+                int minDistance = 0;        //!< minimum pixels between peaks (taller peaks win)
+            };
+
+            struct Peak
+            {
+                double pixel = 0;           //!< sub-pixel centroid
+                double wavelength = 0;      //!< nm (filled by Spectrometer::findPeaks)
+                double wavenumber = 0;      //!< cm-1 (filled by Spectrometer::findPeaks)
+                double intensity = 0;       //!< at the apex pixel
+                double prominence = 0;
+                double width = 0;           //!< pixels, at half prominence
+            };
+
+            int find(const double* spectrum, int len, const Params& params, int maxPeaks, std::vector<Peak>& peaks);
+
+        private:
+            std::mutex mutScratch;
+            std::vector<uint8_t> isMax;
+            std::vector<int> candidates;
+    };
+}
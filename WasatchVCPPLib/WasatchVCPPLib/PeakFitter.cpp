@@ -0,0 +1,392 @@
+/**
+    @file   PeakFitter.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::PeakFitter
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "PeakFitter.h"
+
+#include <cmath>
+#include <algorithm>
+
+using std::vector;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::max;
+using std::min;
+
+namespace
+{
+    const int MAX_PARAMS = 6;
+    const int MAX_ITERATIONS = 100;
+    const int MAX_DEFAULT_THREADS = 8;
+    const double MAX_LAMBDA = 1e10;
+    const double CONVERGENCE = 1e-8;       //!< relative change in chi-squared or any parameter
+    const double FOUR_LN2 = 2.772588722239781;
+    const double PI = 3.141592653589793;
+
+    //! the baseline is linear: p[P_OFFSET] + p[P_SLOPE] * (x - origin)
+    enum Param { P_AMPLITUDE, P_CENTER, P_FWHM, P_OFFSET, P_SLOPE, P_ETA };
+
+    //! @returns the model at x, optionally filling its partial derivatives
+    inline double evaluate(WasatchVCPP::PeakFitter::Shape shape, const double* p, double x, double origin, double* grad)
+    {
+        const double d = x - p[P_CENTER];
+        const double w = p[P_FWHM];
+        const double w2 = w * w;
+        const double d2w2 = d * d / w2;
+
+        double eta = 0;
+        double g = 0;
+        double l = 0;
+        if (shape != WasatchVCPP::PeakFitter::SHAPE_LORENTZIAN)
+            g = exp(-FOUR_LN2 * d2w2);
+        if (shape != WasatchVCPP::PeakFitter::SHAPE_GAUSSIAN)
+            l = 1 / (1 + 4 * d2w2);
+        if (shape == WasatchVCPP::PeakFitter::SHAPE_LORENTZIAN)
+            eta = 1;
+        else if (shape == WasatchVCPP::PeakFitter::SHAPE_PSEUDO_VOIGT)
+            eta = p[P_ETA];
+
+        const double profile = eta * l + (1 - eta) * g;
+        if (grad != nullptr)
+        {
+            // d/dfwhm of either profile is d/dcenter * d / w
+            double dCenter = eta * l * l * 8 * d / w2 + (1 - eta) * g * 2 * FOUR_LN2 * d / w2;
+            grad[P_AMPLITUDE] = profile;
+            grad[P_CENTER] = p[P_AMPLITUDE] * dCenter;
+            grad[P_FWHM] = p[P_AMPLITUDE] * dCenter * d / w;
+            grad[P_OFFSET] = 1;
+            grad[P_SLOPE] = x - origin;
+            grad[P_ETA] = p[P_AMPLITUDE] * (l - g);
+        }
+        return p[P_AMPLITUDE] * profile + p[P_OFFSET] + p[P_SLOPE] * (x - origin);
+    }
+
+    double chiSquared(WasatchVCPP::PeakFitter::Shape shape, const double* p, const double* spectrum, int lo, int hi, double origin)
+    {
+        double sum = 0;
+        for (int x = lo; x <= hi; x++)
+        {
+            double r = spectrum[x] - evaluate(shape, p, x, origin, nullptr);
+            sum += r * r;
+        }
+        return sum;
+    }
+
+    //! solve the n x n symmetric positive-definite system a * x = b by Cholesky
+    //! decomposition (a is overwritten)
+    bool solve(int n, double a[][MAX_PARAMS], const double* b, double* x)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            double sum = a[j][j];
+            for (int k = 0; k < j; k++)
+                sum -= a[j][k] * a[j][k];
+            if (!(sum > 0))
+                return false;
+            a[j][j] = sqrt(sum);
+            for (int i = j + 1; i < n; i++)
+            {
+                double s = a[i][j];
+                for (int k = 0; k < j; k++)
+                    s -= a[i][k] * a[j][k];
+                a[i][j] = s / a[j][j];
+            }
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            double s = b[i];
+            for (int k = 0; k < i; k++)
+                s -= a[i][k] * x[k];
+            x[i] = s / a[i][i];
+        }
+        for (int i = n - 1; i >= 0; i--)
+        {
+            double s = x[i];
+            for (int k = i + 1; k < n; k++)
+                s -= a[k][i] * x[k];
+            x[i] = s / a[i][i];
+        }
+        return true;
+    }
+}
+
+WasatchVCPP::PeakFitter::PeakFitter()
+{
+}
+
+WasatchVCPP::PeakFitter::~PeakFitter()
+{
+    stopWorkers();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Configuration
+////////////////////////////////////////////////////////////////////////////////
+
+//! @param n (Input) total threads fitting peaks, including the caller's
+//!        (zero for one per core, up to MAX_DEFAULT_THREADS)
+void WasatchVCPP::PeakFitter::setThreads(int n)
+{
+    lock_guard<mutex> lock(mutFit);
+    configureThreads(n);
+}
+
+int WasatchVCPP::PeakFitter::getThreads()
+{
+    lock_guard<mutex> lock(mutFit);
+    if (threads < 0)
+        configureThreads(0);
+    return threads;
+}
+
+//! @note caller must hold mutFit
+void WasatchVCPP::PeakFitter::configureThreads(int n)
+{
+    stopWorkers();
+    if (n <= 0)
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        n = cores > 0 ? min((int)cores, MAX_DEFAULT_THREADS) : 1;
+    }
+    threads = n;
+    startWorkers(threads - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Fitting
+////////////////////////////////////////////////////////////////////////////////
+
+//! Fit each guessed peak independently.
+//!
+//! @param spectrum (Input) intensities
+//! @param len (Input) length of spectrum
+//! @param shape (Input) line shape to fit
+//! @param guesses (Input) initial estimate of each peak
+//! @param fits (Output) one fit per guess, in the same order
+//! @returns number of fits which converged
+int WasatchVCPP::PeakFitter::fit(const double* spectrum, int len, Shape shape, const vector<Guess>& guesses, vector<Fit>& fits)
+{
+    lock_guard<mutex> lock(mutFit);
+    if (threads < 0)
+        configureThreads(0);
+
+    fits.resize(guesses.size());
+    if (guesses.empty() || spectrum == nullptr)
+        return 0;
+
+    jobSpectrum = spectrum;
+    jobLen = len;
+    jobShape = shape;
+    jobGuesses = &guesses;
+    jobFits = &fits;
+    nextJob = 0;
+
+    if (workers.empty() || guesses.size() < 2)
+        runJobs();
+    else
+    {
+        {
+            lock_guard<mutex> poolLock(mutPool);
+            busy = (int)workers.size();
+            generation++;
+        }
+        cvWork.notify_all();
+
+        runJobs();
+
+        unique_lock<mutex> poolLock(mutPool);
+        cvDone.wait(poolLock, [this]{ return busy == 0; });
+    }
+
+    jobGuesses = nullptr;
+    jobFits = nullptr;
+
+    int converged = 0;
+    for (const auto& f : fits)
+        if (f.converged)
+            converged++;
+    return converged;
+}
+
+//! Fit a single peak by Levenberg-Marquardt.
+//!
+//! @returns the fit (converged is false if the guess lies outside the
+//!          spectrum, or the solver ran out of iterations)
+WasatchVCPP::PeakFitter::Fit WasatchVCPP::PeakFitter::fitWindow(const double* spectrum, int len, Shape shape, const Guess& guess)
+{
+    Fit fit;
+    fit.pixel = guess.pixel;
+
+    const int nParams = shape == SHAPE_PSEUDO_VOIGT ? 6 : 5;
+    if (!(guess.pixel >= 0 && guess.pixel <= len - 1))
+        return fit;
+
+    int apex = (int)(guess.pixel + 0.5);
+    double fwhm = guess.fwhm > 0 ? guess.fwhm : 3;
+    int half = max(3, (int)ceil(1.5 * fwhm));
+    int lo = max(0, apex - half);
+    int hi = min(len - 1, apex + half);
+    if (hi - lo + 1 <= nParams)
+        return fit;
+
+    // start from a baseline joining the ends of the window
+    const double origin = apex;
+    double p[MAX_PARAMS] = { 0 };
+    p[P_SLOPE] = (spectrum[hi] - spectrum[lo]) / (hi - lo);
+    p[P_OFFSET] = spectrum[lo] + p[P_SLOPE] * (origin - lo);
+    p[P_AMPLITUDE] = guess.amplitude > 0 ? guess.amplitude : spectrum[apex] - p[P_OFFSET];
+    p[P_CENTER] = guess.pixel;
+    p[P_FWHM] = fwhm;
+    p[P_ETA] = 0.5;
+
+    double chi2 = chiSquared(shape, p, spectrum, lo, hi, origin);
+    double lambda = 1e-3;
+    int iter = 0;
+    for ( ; iter < MAX_ITERATIONS; iter++)
+    {
+        // normal equations
+        double jtj[MAX_PARAMS][MAX_PARAMS] = { { 0 } };
+        double jtr[MAX_PARAMS] = { 0 };
+        for (int x = lo; x <= hi; x++)
+        {
+            double grad[MAX_PARAMS];
+            double r = spectrum[x] - evaluate(shape, p, x, origin, grad);
+            for (int i = 0; i < nParams; i++)
+            {
+                jtr[i] += grad[i] * r;
+                for (int j = 0; j <= i; j++)
+                    jtj[i][j] += grad[i] * grad[j];
+            }
+        }
+
+        // increase damping until a step reduces chi-squared
+        bool improved = false;
+        double change = 0;
+        while (!improved && lambda < MAX_LAMBDA)
+        {
+            double a[MAX_PARAMS][MAX_PARAMS];
+            for (int i = 0; i < nParams; i++)
+            {
+                for (int j = 0; j <= i; j++)
+                    a[i][j] = jtj[i][j];
+                a[i][i] += lambda * max(jtj[i][i], 1e-12);
+            }
+
+            double delta[MAX_PARAMS];
+            double trial[MAX_PARAMS];
+            if (solve(nParams, a, jtr, delta))
+            {
+                for (int i = 0; i < MAX_PARAMS; i++)
+                    trial[i] = p[i] + (i < nParams ? delta[i] : 0);
+                trial[P_ETA] = min(1.0, max(0.0, trial[P_ETA]));
+
+                if (trial[P_FWHM] > 0 && trial[P_CENTER] >= lo && trial[P_CENTER] <= hi)
+                {
+                    double trialChi2 = chiSquared(shape, trial, spectrum, lo, hi, origin);
+                    if (trialChi2 <= chi2)
+                    {
+                        change = chi2 > 0 ? (chi2 - trialChi2) / chi2 : 0;
+                        for (int i = 0; i < nParams; i++)
+                            if (i != P_SLOPE)
+                                change = max(change, fabs(trial[i] - p[i]) / max(fabs(p[i]), 1e-3));
+                        chi2 = trialChi2;
+                        for (int i = 0; i < MAX_PARAMS; i++)
+                            p[i] = trial[i];
+                        improved = true;
+                    }
+                }
+            }
+
+            if (improved)
+                lambda = max(lambda / 10, 1e-12);
+            else
+                lambda *= 10;
+        }
+
+        // no step can reduce chi-squared further, or the last changed nothing much
+        if (!improved || change < CONVERGENCE)
+        {
+            fit.converged = true;
+            iter++;
+            break;
+        }
+    }
+
+    const double eta = shape == SHAPE_GAUSSIAN ? 0 : shape == SHAPE_LORENTZIAN ? 1 : p[P_ETA];
+    const double gaussianArea = p[P_FWHM] * sqrt(PI / FOUR_LN2);
+    const double lorentzianArea = p[P_FWHM] * PI / 2;
+
+    fit.pixel = p[P_CENTER];
+    fit.fwhm = p[P_FWHM];
+    fit.amplitude = p[P_AMPLITUDE];
+    fit.area = p[P_AMPLITUDE] * (eta * lorentzianArea + (1 - eta) * gaussianArea);
+    fit.baseline = p[P_OFFSET] + p[P_SLOPE] * (p[P_CENTER] - origin);
+    fit.eta = eta;
+    fit.rms = sqrt(chi2 / (hi - lo + 1));
+    fit.iterations = iter;
+    return fit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Worker Pool
+////////////////////////////////////////////////////////////////////////////////
+
+//! claim and fit windows from the current job until none remain
+void WasatchVCPP::PeakFitter::runJobs()
+{
+    const int count = (int)jobGuesses->size();
+    for (int i = nextJob++; i < count; i = nextJob++)
+        (*jobFits)[i] = fitWindow(jobSpectrum, jobLen, jobShape, (*jobGuesses)[i]);
+}
+
+//! @note caller must hold mutFit
+void WasatchVCPP::PeakFitter::startWorkers(int n)
+{
+    for (int i = 0; i < n; i++)
+        workers.push_back(std::thread(&PeakFitter::workerLoop, this, generation));
+}
+
+//! @note caller must hold mutFit (except from the destructor)
+void WasatchVCPP::PeakFitter::stopWorkers()
+{
+    {
+        lock_guard<mutex> lock(mutPool);
+        stopping = true;
+    }
+    cvWork.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+
+    lock_guard<mutex> lock(mutPool);
+    stopping = false;
+}
+
+//! @param seen (Input) generation of the last job posted before this worker
+//!        was started
+void WasatchVCPP::PeakFitter::workerLoop(uint64_t seen)
+{
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(mutPool);
+            cvWork.wait(lock, [&]{ return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        runJobs();
+
+        lock_guard<mutex> lock(mutPool);
+        if (--busy == 0)
+            cvDone.notify_all();
+    }
+}
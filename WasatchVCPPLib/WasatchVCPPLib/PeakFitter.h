@@ -0,0 +1,100 @@
+/**
+    @file   PeakFitter.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::PeakFitter
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+namespace WasatchVCPP
+{
+    //! Internal class fitting analytic line shapes to peaks within a spectrum.
+    //!
+    //! Each peak is fit independently over a window of +/- 1.5 FWHM around its
+    //! initial guess, using Levenberg-Marquardt on amplitude, center, FWHM,
+    //! a linear baseline and (for pseudo-Voigt) the Lorentzian fraction.
+    //! All solver state is on the stack, so windows are distributed across a
+    //! small pool of worker threads (plus the calling thread) which persist
+    //! between calls.
+    //!
+    //! Overlapping peaks are not fit jointly; each window simply sees its
+    //! neighbors' tails as part of the baseline.
+    class PeakFitter
+    {
+        public:
+            enum Shape
+            {
+                SHAPE_GAUSSIAN,
+                SHAPE_LORENTZIAN,
+                SHAPE_PSEUDO_VOIGT
+            };
+
+            //! initial estimate (non-positive fwhm or amplitude are estimated from the spectrum)
+            struct Guess
+            {
+                double pixel = 0;
+                double fwhm = 0;
+                double amplitude = 0;       //!< height above baseline
+            };
+
+            struct Fit
+            {
+                double pixel = 0;           //!< fitted center
+                double wavelength = 0;      //!< nm (filled by Spectrometer::fitPeaks)
+                double wavenumber = 0;      //!< cm-1 (filled by Spectrometer::fitPeaks)
+                double fwhm = 0;            //!< pixels
+                double amplitude = 0;       //!< height above baseline
+                double area = 0;            //!< amplitude integrated over pixels
+                double baseline = 0;
+                double eta = 0;             //!< Lorentzian fraction (1 for SHAPE_LORENTZIAN)
+                double rms = 0;             //!< residual within the window
+                int iterations = 0;
+                bool converged = false;
+            };
+
+            PeakFitter();
+            ~PeakFitter();
+
+            void setThreads(int n);
+            int getThreads();
+
+            int fit(const double* spectrum, int len, Shape shape, const std::vector<Guess>& guesses, std::vector<Fit>& fits);
+
+            static Fit fitWindow(const double* spectrum, int len, Shape shape, const Guess& guess);
+
+        private:
+            std::mutex mutFit;              //!< serializes calls to fit()
+
+            // worker pool
+            std::vector<std::thread> workers;
+            std::mutex mutPool;
+            std::condition_variable cvWork;
+            std::condition_variable cvDone;
+            uint64_t generation = 0;        //!< incremented to post each job
+            int busy = 0;                   //!< workers yet to finish the current job
+            bool stopping = false;
+            int threads = -1;               //!< total including caller (-1 until first used)
+
+            // current job
+            const double* jobSpectrum = nullptr;
+            int jobLen = 0;
+            Shape jobShape = SHAPE_GAUSSIAN;
+            const std::vector<Guess>* jobGuesses = nullptr;
+            std::vector<Fit>* jobFits = nullptr;
+            std::atomic<int> nextJob{0};
+
+            void configureThreads(int n);
+            void startWorkers(int n);
+            void stopWorkers();
+            void workerLoop(uint64_t seen);
+            void runJobs();
+    };
+}
@@ -0,0 +1,674 @@
+/**
+    @file   ProcessingPipeline.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::ProcessingPipeline
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "ProcessingPipeline.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+using std::vector;
+using std::mutex;
+using std::lock_guard;
+using std::min;
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* STAGE_NAMES[] = { "total", "badPixels", "bin2x2", "dark", "ramanIntensity", "ratio", "savitzkyGolay", "baseline" };
+
+static double elapsedUS(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+//! Take stage defaults and calibrations from a freshly-read EEPROM.
+//!
+//! @param eeprom (Input) parsed EEPROM (bad pixels, ROI, feature mask)
+//! @param ramanIntensityFactors (Input) per-pixel SRM factors (empty if none)
+void WasatchVCPP::ProcessingPipeline::init(const EEPROM& eeprom, const vector<double>& ramanIntensityFactors)
+{
+    lock_guard<mutex> lock(mutPipeline);
+
+    pixels = eeprom.activePixelsHoriz;
+    badPixelRuns = eeprom.badPixelRuns;
+    invertX = eeprom.featureMask.invertXAxis;
+    bin2x2 = eeprom.featureMask.bin2x2;
+
+    ramanIntensityScale.clear();
+    ramanIntensityCorrection = false;
+    if (!ramanIntensityFactors.empty())
+    {
+        ramanIntensityScale.assign(pixels, 1.0);
+        int end = min((int)eeprom.ROIHorizEnd, min(pixels, (int)ramanIntensityFactors.size()) - 1);
+        for (int px = eeprom.ROIHorizStart; px <= end; px++)
+            ramanIntensityScale[px] = ramanIntensityFactors[px];
+    }
+
+    nonlinearityCorrection = false;
+    buildLinearityLUT(eeprom.linearityCoeffs, 5);
+
+    dark.clear();
+    reference.clear();
+    mode = MODE_SCOPE;
+    rebuildPixelMap();
+}
+
+//! Combine dark subtraction, Raman intensity correction and the ratio 
+//! against the reference into a single offset and gain per pixel.
+//!
+//! In ratio modes the SRM is not applied, as it would cancel out.  Pixels 
+//! where the reference does not exceed the dark get zero gain (and so the
+//! maximum absorbance, see toAbsorbance).
+//!
+//! @note caller must hold mutPipeline
+void WasatchVCPP::ProcessingPipeline::rebuildPixelMap()
+{
+    pixelOffset.clear();
+    pixelGain.clear();
+    ratioGain.clear();
+
+    bool ratio = mode != MODE_SCOPE && !reference.empty();
+    bool srm = mode == MODE_SCOPE && ramanIntensityCorrection;
+    if (ratio)
+    {
+        double numerator = mode == MODE_ABSORBANCE ? 1 : 100;
+        ratioGain.resize(pixels);
+        for (int i = 0; i < pixels; i++)
+        {
+            double denominator = reference[i] - (dark.empty() ? 0 : dark[i]);
+            ratioGain[i] = denominator > 0 ? numerator / denominator : 0;
+        }
+    }
+
+    if (dark.empty() && !ratio && !srm)
+        return;
+
+    if (dark.empty())
+        pixelOffset.assign(pixels, 0.0);
+    else
+        pixelOffset = dark;
+
+    if (ratio)
+        pixelGain = ratioGain;
+    else if (srm)
+        pixelGain = ramanIntensityScale;
+    else
+        pixelGain.assign(pixels, 1.0);
+}
+
+//! Evaluate the EEPROM's nonlinearity polynomial at every possible 16-bit 
+//! count, so correcting a pixel is one table lookup.
+//!
+//! The table is left empty if the coefficients are unset (all zero), 
+//! invalid (NaN) or the identity.
+void WasatchVCPP::ProcessingPipeline::buildLinearityLUT(const float* coeffs, int count)
+{
+    linearityLUT.clear();
+
+    bool identity = true;
+    bool zero = true;
+    for (int i = 0; i < count; i++)
+    {
+        if (std::isnan(coeffs[i]))
+            return;
+        if (coeffs[i] != 0)
+            zero = false;
+        if (coeffs[i] != (i == 1 ? 1 : 0))
+            identity = false;
+    }
+    if (zero || identity)
+        return;
+
+    linearityLUT.resize(65536);
+    for (int x = 0; x < 65536; x++)
+    {
+        double y = 0;
+        for (int i = count - 1; i >= 0; i--)
+            y = y * x + coeffs[i];
+        linearityLUT[x] = (float)y;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Processing
+////////////////////////////////////////////////////////////////////////////////
+
+//! Apply all enabled stages, in-place, to one demarshalled spectrum.
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::process(T* spectrum)
+{
+    lock_guard<mutex> lock(mutPipeline);
+
+    auto start = Clock::now();
+    // instantiate the fused pass per combination of per-pixel stages, so its
+    // inner loop carries no stage checks
+    bool scale = !pixelGain.empty();
+    bool absorbance = scale && mode == MODE_ABSORBANCE;
+    if (profiling)
+        processProfiled(spectrum);
+    else
+    {
+        if (bin2x2)
+            absorbance ? processFused<T, true, true, true>(spectrum)
+          : scale      ? processFused<T, true, true, false>(spectrum)
+                       : processFused<T, true, false, false>(spectrum);
+        else
+            absorbance ? processFused<T, false, true, true>(spectrum)
+          : scale      ? processFused<T, false, true, false>(spectrum)
+                       : processFused<T, false, false, false>(spectrum);
+        savitzkyGolay.apply(spectrum, pixels);
+        baselineRemover.apply(spectrum, pixels);
+    }
+
+    stageTimeUS[STAGE_TOTAL] += elapsedUS(start);
+    stageCalls[STAGE_TOTAL]++;
+}
+
+//! Raw spectra only receive bad-pixel correction (in integer arithmetic).
+void WasatchVCPP::ProcessingPipeline::process(uint16_t* spectrum)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    if (badPixelCorrection)
+        correctBadPixels(spectrum);
+}
+
+//! -log10(ratio), via the natural log (which is markedly faster than log10
+//! in common libms, and within an ulp or two of it).
+//!
+//! Ratios are floored at MIN_ABSORBANCE_RATIO (so absorbance is capped at 
+//! 6), as pixels where the sample or reference doesn't exceed the dark 
+//! would otherwise yield inf or NaN, which Savitzky-Golay and baseline 
+//! removal would then smear across their neighbours.
+template<typename T>
+static inline T toAbsorbance(T ratio)
+{
+    const double NEG_LOG10_E = -0.43429448190325182765;
+    const double MIN_ABSORBANCE_RATIO = 1e-6;
+
+    // written so that NaN also takes the floor
+    double r = ratio > MIN_ABSORBANCE_RATIO ? (double)ratio : MIN_ABSORBANCE_RATIO;
+    return (T)(NEG_LOG10_E * log(r));
+}
+
+//! Dark-correct and scale one pixel (the arithmetic, including rounding to T
+//! between steps, mirrors subtractDark followed by applyRamanIntensity or 
+//! applyRatio).
+template<typename T, bool LOG>
+static inline T mapPixel(T value, double offset, double gain)
+{
+    T corrected = (T)(value - offset);
+    T scaled = (T)(corrected * gain);
+    return LOG ? toAbsorbance(scaled) : scaled;
+}
+
+//! All stages in a single forward pass.
+//!
+//! Each pixel is finalized one step behind the pixel being read: 'carry'
+//! holds the bad-pixel-corrected value of pixel i-1, which 2x2 binning needs
+//! to pair with pixel i (and which a bad-pixel run starting at i uses as its
+//! left endpoint).  Since writes trail reads, the raw right endpoint of a
+//! run is still intact when we look ahead to it.
+//!
+//! The arithmetic deliberately mirrors correctBadPixels, binPixels and
+//! the per-pixel map stages, so results are identical to processProfiled.
+template<typename T, bool BIN, bool SCALE, bool LOG>
+void WasatchVCPP::ProcessingPipeline::processFused(T* spectrum)
+{
+    if (pixels < 1)
+        return;
+
+    const double* offset = pixelOffset.data();
+    const double* gain = pixelGain.data();
+
+    const EEPROM::BadPixelRun* run = badPixelRuns.data();
+    const EEPROM::BadPixelRun* runsEnd = run + (badPixelCorrection ? badPixelRuns.size() : 0);
+
+    T carry = 0;
+    auto emit = [&](int i, T value)
+    {
+        if (i > 0)
+        {
+            T z = BIN ? (T)((carry + value) / 2.0) : carry;
+            spectrum[i - 1] = SCALE ? mapPixel<T, LOG>(z, offset[i - 1], gain[i - 1]) : z;
+        }
+        carry = value;
+    };
+
+    int i = 0;
+    while (i < pixels)
+    {
+        if (run != runsEnd && run->start == i)
+        {
+            // prevGood == i - 1 unless this is a left-edge run, in which case
+            // both endpoints are the (still raw) nextGood
+            T prev = run->prevGood < i ? carry : spectrum[run->prevGood];
+            T next = run->nextGood < i ? carry : spectrum[run->nextGood];
+            float deltaIntensity = next - prev;
+            float intensityPerPix = deltaIntensity / run->span;
+            for (int j = 0; j < run->span - 1; j++, i++)
+                emit(i, (T)(prev + intensityPerPix * (j + 1)));
+            run++;
+        }
+        else
+        {
+            emit(i, spectrum[i]);
+            i++;
+        }
+    }
+
+    // binning leaves the last pixel as-is
+    spectrum[pixels - 1] = SCALE ? mapPixel<T, LOG>(carry, offset[pixels - 1], gain[pixels - 1]) : carry;
+}
+
+//! Interpolate a processed spectrum (of native pixels) onto the output axis.
+//!
+//! The indices and weights were computed by setOutputAxis, so this is a 
+//! single branch-free pass which the compiler can vectorize (given gather 
+//! instructions).
+//!
+//! @param spectrum (Input) processed spectrum of 'pixels' intensities
+//! @param output (Output) receives getOutputLength() intensities
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::resample(const double* spectrum, T* output)
+{
+    lock_guard<mutex> lock(mutPipeline);
+
+    const int* index = resampleIndex.data();
+    const double* weight = resampleWeight.data();
+    const int count = (int)resampleIndex.size();
+    for (int k = 0; k < count; k++)
+    {
+        double lo = spectrum[index[k]];
+        double hi = spectrum[index[k] + 1];
+        output[k] = (T)(lo + weight[k] * (hi - lo));
+    }
+}
+
+//! Each stage as its own pass, individually timed.
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::processProfiled(T* spectrum)
+{
+    Clock::time_point start;
+
+    if (badPixelCorrection)
+    {
+        start = Clock::now();
+        correctBadPixels(spectrum);
+        stageTimeUS[STAGE_BAD_PIXELS] += elapsedUS(start);
+        stageCalls[STAGE_BAD_PIXELS]++;
+    }
+
+    if (bin2x2)
+    {
+        start = Clock::now();
+        binPixels(spectrum);
+        stageTimeUS[STAGE_BIN_2X2] += elapsedUS(start);
+        stageCalls[STAGE_BIN_2X2]++;
+    }
+
+    if (!dark.empty())
+    {
+        start = Clock::now();
+        subtractDark(spectrum);
+        stageTimeUS[STAGE_DARK] += elapsedUS(start);
+        stageCalls[STAGE_DARK]++;
+    }
+
+    if (!ratioGain.empty())
+    {
+        start = Clock::now();
+        applyRatio(spectrum);
+        stageTimeUS[STAGE_RATIO] += elapsedUS(start);
+        stageCalls[STAGE_RATIO]++;
+    }
+    else if (ramanIntensityCorrection)
+    {
+        start = Clock::now();
+        applyRamanIntensity(spectrum);
+        stageTimeUS[STAGE_RAMAN_INTENSITY] += elapsedUS(start);
+        stageCalls[STAGE_RAMAN_INTENSITY]++;
+    }
+
+    if (savitzkyGolay.isEnabled())
+    {
+        start = Clock::now();
+        savitzkyGolay.apply(spectrum, pixels);
+        stageTimeUS[STAGE_SAVITZKY_GOLAY] += elapsedUS(start);
+        stageCalls[STAGE_SAVITZKY_GOLAY]++;
+    }
+
+    if (baselineRemover.getMethod() != BaselineRemover::METHOD_NONE)
+    {
+        start = Clock::now();
+        baselineRemover.apply(spectrum, pixels);
+        stageTimeUS[STAGE_BASELINE] += elapsedUS(start);
+        stageCalls[STAGE_BASELINE]++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Individual stages
+////////////////////////////////////////////////////////////////////////////////
+
+//! Draw a line across one bad-pixel run.  At the detector edges the run's
+//! endpoints are the same pixel, so the slope is zero and the run is filled
+//! with that pixel's value.
+template<typename T>
+static inline void interpolateBadPixels(T* spectrum, const WasatchVCPP::EEPROM::BadPixelRun& run)
+{
+    T prev = spectrum[run.prevGood];
+    float deltaIntensity = spectrum[run.nextGood] - prev;
+    float intensityPerPix = deltaIntensity / run.span;
+    T* dest = spectrum + run.start;
+    for (int j = 0; j < run.span - 1; j++)
+        dest[j] = prev + intensityPerPix * (j + 1);
+}
+
+//! integer version for raw spectra (rounds to nearest count)
+static inline void interpolateBadPixels(uint16_t* spectrum, const WasatchVCPP::EEPROM::BadPixelRun& run)
+{
+    int prev = spectrum[run.prevGood];
+    int deltaIntensity = spectrum[run.nextGood] - prev;
+    int rangePix = run.span;
+    uint16_t* dest = spectrum + run.start;
+    for (int j = 0; j < rangePix - 1; j++)
+    {
+        int step = deltaIntensity * (j + 1);
+        step = step >= 0 ? (step + rangePix / 2) / rangePix : -((-step + rangePix / 2) / rangePix);
+        dest[j] = (uint16_t)(prev + step);
+    }
+}
+
+//! Averages over bad pixels in-place, using the runs precompiled by
+//! EEPROM::compileBadPixelRuns.
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::correctBadPixels(T* spectrum)
+{
+    for (const auto& run : badPixelRuns)
+        interpolateBadPixels(spectrum, run);
+}
+
+//! perform 2x2 binning for Bayer filters
+//!
+//! Each output pixel only depends on itself and its (not yet overwritten)
+//! right-hand neighbor, so this can safely run in-place.
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::binPixels(T* spectrum)
+{
+    for (int i = 0; i < pixels - 1; i++)
+        spectrum[i] = (T)((spectrum[i] + spectrum[i + 1]) / 2.0);
+}
+
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::subtractDark(T* spectrum)
+{
+    const double* d = dark.data();
+    for (int px = 0; px < pixels; px++)
+        spectrum[px] = (T)(spectrum[px] - d[px]);
+}
+
+//! scale the horizontal ROI by the cached SRM factors
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::applyRamanIntensity(T* spectrum)
+{
+    const double* scale = ramanIntensityScale.data();
+    for (int px = 0; px < pixels; px++)
+        spectrum[px] = (T)(spectrum[px] * scale[px]);
+}
+
+//! ratio a dark-corrected spectrum against the (dark-corrected) reference,
+//! as percent or absorbance
+template<typename T>
+void WasatchVCPP::ProcessingPipeline::applyRatio(T* spectrum)
+{
+    const double* gain = ratioGain.data();
+    for (int px = 0; px < pixels; px++)
+        spectrum[px] = (T)(spectrum[px] * gain[px]);
+
+    if (mode == MODE_ABSORBANCE)
+        for (int px = 0; px < pixels; px++)
+            spectrum[px] = toAbsorbance(spectrum[px]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Configuration
+////////////////////////////////////////////////////////////////////////////////
+
+void WasatchVCPP::ProcessingPipeline::setInvertX(bool flag)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    invertX = flag;
+}
+
+void WasatchVCPP::ProcessingPipeline::setBadPixelCorrection(bool flag)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    badPixelCorrection = flag;
+}
+
+void WasatchVCPP::ProcessingPipeline::setBin2x2(bool flag)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    bin2x2 = flag;
+}
+
+//! @returns false if enabling without an SRM calibration
+bool WasatchVCPP::ProcessingPipeline::setRamanIntensityCorrection(bool flag)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    if (flag && ramanIntensityScale.empty())
+        return false;
+    ramanIntensityCorrection = flag;
+    rebuildPixelMap();
+    return true;
+}
+
+//! Store a dark, to be subtracted from subsequent spectra.
+//!
+//! @param spectrum (Input) freshly acquired spectrum of 'pixels' (bad-pixel
+//!        correction and binning are applied here, exactly as they will be 
+//!        to the spectra it corrects; the vector is consumed)
+//! @returns false if the wrong length
+bool WasatchVCPP::ProcessingPipeline::setDark(vector<double>& spectrum)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    if ((int)spectrum.size() != pixels || pixels < 1)
+        return false;
+
+    bin2x2 ? processFused<double, true, false, false>(spectrum.data())
+           : processFused<double, false, false, false>(spectrum.data());
+    dark.swap(spectrum);
+    rebuildPixelMap();
+    return true;
+}
+
+//! Store a reference (e.g. a white standard, or a blank), against which 
+//! subsequent spectra are ratioed in transmission, reflectance and 
+//! absorbance modes.
+//!
+//! @see setDark
+bool WasatchVCPP::ProcessingPipeline::setReference(vector<double>& spectrum)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    if ((int)spectrum.size() != pixels || pixels < 1)
+        return false;
+
+    bin2x2 ? processFused<double, true, false, false>(spectrum.data())
+           : processFused<double, false, false, false>(spectrum.data());
+    reference.swap(spectrum);
+    rebuildPixelMap();
+    return true;
+}
+
+void WasatchVCPP::ProcessingPipeline::clearDark()
+{
+    lock_guard<mutex> lock(mutPipeline);
+    dark.clear();
+    rebuildPixelMap();
+}
+
+//! reverts to MODE_SCOPE
+void WasatchVCPP::ProcessingPipeline::clearReference()
+{
+    lock_guard<mutex> lock(mutPipeline);
+    reference.clear();
+    mode = MODE_SCOPE;
+    rebuildPixelMap();
+}
+
+//! @returns false if selecting a ratio mode with no reference stored
+bool WasatchVCPP::ProcessingPipeline::setMode(Mode mode)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    if (mode != MODE_SCOPE && reference.empty())
+        return false;
+    this->mode = mode;
+    rebuildPixelMap();
+    return true;
+}
+
+//! @returns false if enabling without a nonlinearity calibration
+bool WasatchVCPP::ProcessingPipeline::setNonlinearityCorrection(bool flag)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    if (flag && linearityLUT.empty())
+        return false;
+    nonlinearityCorrection = flag;
+    return true;
+}
+
+//! @returns false if a parameter is out of range
+bool WasatchVCPP::ProcessingPipeline::setSavitzkyGolay(int halfWidth, int order, int derivative)
+{
+    SavitzkyGolay filter;
+    if (!filter.configure(halfWidth, order, derivative))
+        return false;
+
+    // kernels are computed outside the lock, so acquisition isn't held up
+    lock_guard<mutex> lock(mutPipeline);
+    savitzkyGolay = filter;
+    return true;
+}
+
+//! @returns false if a parameter is out of range
+bool WasatchVCPP::ProcessingPipeline::setBaselineRemoval(BaselineRemover::Method method, double lambda, double p, int maxIterations)
+{
+    lock_guard<mutex> lock(mutPipeline);
+    return baselineRemover.configure(method, lambda, p, maxIterations);
+}
+
+//! @returns the nonlinearity lookup table, or nullptr if correction is disabled
+const float* WasatchVCPP::ProcessingPipeline::getLinearityLUT()
+{
+    return nonlinearityCorrection ? linearityLUT.data() : nullptr;
+}
+
+//! Precompute linear interpolation from the native pixel axis onto 'count'
+//! points starting at 'start', spaced 'step' apart.  Points beyond either end
+//! of the native axis take the value of the first or last pixel.
+//!
+//! @param axis (Input) native x-coordinate of each pixel (wavelengths or
+//!        wavenumbers), which must be strictly increasing
+//! @returns false if the requested or native axis is invalid
+bool WasatchVCPP::ProcessingPipeline::setOutputAxis(double start, double step, int count, const vector<double>& axis)
+{
+    int n = (int)axis.size();
+    if (count < 1 || !(step > 0) || std::isnan(start) || n < 2 || n != pixels)
+        return false;
+    for (int i = 1; i < n; i++)
+        if (!(axis[i] > axis[i - 1]))
+            return false;
+
+    vector<int> index(count);
+    vector<double> weight(count);
+    for (int k = 0; k < count; k++)
+    {
+        double x = start + k * step;
+        int i = (int)(std::upper_bound(axis.begin(), axis.end(), x) - axis.begin()) - 1;
+        i = std::max(0, min(i, n - 2));
+        double w = (x - axis[i]) / (axis[i + 1] - axis[i]);
+        index[k] = i;
+        weight[k] = std::max(0.0, std::min(1.0, w));
+    }
+
+    lock_guard<mutex> lock(mutPipeline);
+    resampleIndex.swap(index);
+    resampleWeight.swap(weight);
+    return true;
+}
+
+void WasatchVCPP::ProcessingPipeline::clearOutputAxis()
+{
+    lock_guard<mutex> lock(mutPipeline);
+    resampleIndex.clear();
+    resampleWeight.clear();
+}
+
+//! @returns points in the output axis, or 0 if not resampling
+int WasatchVCPP::ProcessingPipeline::getOutputLength()
+{
+    lock_guard<mutex> lock(mutPipeline);
+    return (int)resampleIndex.size();
+}
+
+//! Apply stages one pass at a time, timing each (slower).  Resets timing.
+void WasatchVCPP::ProcessingPipeline::setProfiling(bool flag)
+{
+    resetTiming();
+    lock_guard<mutex> lock(mutPipeline);
+    profiling = flag;
+}
+
+bool WasatchVCPP::ProcessingPipeline::getInvertX() { return invertX; }
+bool WasatchVCPP::ProcessingPipeline::getBadPixelCorrection() { return badPixelCorrection; }
+bool WasatchVCPP::ProcessingPipeline::getBin2x2() { return bin2x2; }
+bool WasatchVCPP::ProcessingPipeline::getRamanIntensityCorrection() { return ramanIntensityCorrection; }
+bool WasatchVCPP::ProcessingPipeline::getNonlinearityCorrection() { return nonlinearityCorrection; }
+WasatchVCPP::BaselineRemover::Method WasatchVCPP::ProcessingPipeline::getBaselineRemoval() { return baselineRemover.getMethod(); }
+bool WasatchVCPP::ProcessingPipeline::hasDark() { return !dark.empty(); }
+bool WasatchVCPP::ProcessingPipeline::hasReference() { return !reference.empty(); }
+WasatchVCPP::ProcessingPipeline::Mode WasatchVCPP::ProcessingPipeline::getMode() { return mode; }
+bool WasatchVCPP::ProcessingPipeline::getProfiling() { return profiling; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Profiling
+////////////////////////////////////////////////////////////////////////////////
+
+//! @returns name of the given stage, or nullptr if invalid
+const char* WasatchVCPP::ProcessingPipeline::getStageName(int stage)
+{
+    return 0 <= stage && stage < STAGE_COUNT ? STAGE_NAMES[stage] : nullptr;
+}
+
+//! @returns mean microseconds per spectrum spent in the given stage since
+//!          timing was last reset (individual stages are only timed while
+//!          profiling), or -1 if invalid
+double WasatchVCPP::ProcessingPipeline::getStageTimeUS(int stage)
+{
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return -1;
+
+    lock_guard<mutex> lock(mutPipeline);
+    return stageCalls[stage] ? stageTimeUS[stage] / stageCalls[stage] : 0;
+}
+
+void WasatchVCPP::ProcessingPipeline::resetTiming()
+{
+    lock_guard<mutex> lock(mutPipeline);
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        stageTimeUS[i] = 0;
+        stageCalls[i] = 0;
+    }
+}
+
+// instantiate for wp_get_spectrum and wp_get_spectrum_float
+template void WasatchVCPP::ProcessingPipeline::process<double>(double* spectrum);
+template void WasatchVCPP::ProcessingPipeline::process<float>(float* spectrum);
+template void WasatchVCPP::ProcessingPipeline::resample<double>(const double* spectrum, double* output);
+template void WasatchVCPP::ProcessingPipeline::resample<float>(const double* spectrum, float* output);
@@ -0,0 +1,155 @@
+/**
+    @file   ProcessingPipeline.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::ProcessingPipeline
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include "EEPROM.h"
+#include "BaselineRemover.h"
+#include "SavitzkyGolay.h"
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+namespace WasatchVCPP
+{
+    //! Internal class applying a Spectrometer's post-processing to each
+    //! freshly-demarshalled spectrum.
+    //!
+    //! Rather than making a separate pass over the spectrum for each enabled
+    //! stage, process() applies them all in one forward pass, carrying in
+    //! registers the single pixel of lookahead which bad-pixel interpolation
+    //! and 2x2 binning require.  Invert-X and nonlinearity correction aren't
+    //! applied here at all: they are folded into demarshalling, which simply
+    //! writes pixels in reverse order, and/or looks each raw count up in 
+    //! getLinearityLUT().
+    //!
+    //! Dark subtraction, Raman intensity correction and the transmission / 
+    //! reflectance / absorbance ratio are all per-pixel affine maps, so are
+    //! precombined into one offset and one gain per pixel (see 
+    //! rebuildPixelMap), recomputed only when the dark, reference, mode or
+    //! SRM setting changes.
+    //!
+    //! Savitzky-Golay filtering and baseline removal, which need more than
+    //! one pixel of context, follow as separate passes.
+    //!
+    //! When profiling, the stages are instead applied one pass at a time so
+    //! that each can be timed.  Both paths produce identical results.
+    class ProcessingPipeline
+    {
+        public:
+            //! timed stages (keep synchronized with STAGE_NAMES)
+            enum Stage
+            {
+                STAGE_TOTAL,
+                STAGE_BAD_PIXELS,
+                STAGE_BIN_2X2,
+                STAGE_DARK,
+                STAGE_RAMAN_INTENSITY,
+                STAGE_RATIO,
+                STAGE_SAVITZKY_GOLAY,
+                STAGE_BASELINE,
+                STAGE_COUNT
+            };
+
+            //! what process() reports
+            enum Mode
+            {
+                MODE_SCOPE,                 //!< intensity (dark-corrected, if a dark is stored)
+                MODE_TRANSMISSION,          //!< %T: 100 * (sample - dark) / (reference - dark)
+                MODE_REFLECTANCE,           //!< %R: as transmission
+                MODE_ABSORBANCE             //!< -log10((sample - dark) / (reference - dark)), at most 6
+            };
+
+            void init(const EEPROM& eeprom, const std::vector<double>& ramanIntensityFactors);
+
+            template<typename T> void process(T* spectrum);
+            void process(uint16_t* spectrum);
+            template<typename T> void resample(const double* spectrum, T* output);
+
+            // configuration
+            void setInvertX(bool flag);
+            void setBadPixelCorrection(bool flag);
+            void setBin2x2(bool flag);
+            bool setRamanIntensityCorrection(bool flag);
+            bool setNonlinearityCorrection(bool flag);
+            bool setSavitzkyGolay(int halfWidth, int order, int derivative);
+            bool setBaselineRemoval(BaselineRemover::Method method, double lambda, double p, int maxIterations);
+            bool setDark(std::vector<double>& spectrum);
+            bool setReference(std::vector<double>& spectrum);
+            void clearDark();
+            void clearReference();
+            bool setMode(Mode mode);
+            void setProfiling(bool flag);
+            bool setOutputAxis(double start, double step, int count, const std::vector<double>& axis);
+            void clearOutputAxis();
+            int getOutputLength();
+            bool getInvertX();
+            bool getBadPixelCorrection();
+            bool getBin2x2();
+            bool getRamanIntensityCorrection();
+            bool getNonlinearityCorrection();
+            BaselineRemover::Method getBaselineRemoval();
+            bool hasDark();
+            bool hasReference();
+            Mode getMode();
+            const float* getLinearityLUT();
+            bool getProfiling();
+
+            // profiling
+            static const char* getStageName(int stage);
+            double getStageTimeUS(int stage);
+            void resetTiming();
+
+        private:
+            std::mutex mutPipeline;
+
+            int pixels = 0;
+            std::vector<EEPROM::BadPixelRun> badPixelRuns;
+            std::vector<double> ramanIntensityScale;   //!< per-pixel (1.0 outside the ROI)
+            std::vector<float> linearityLUT;           //!< corrected value of each raw count (empty if uncalibrated)
+
+            std::vector<double> dark;                  //!< stored dark (empty if none)
+            std::vector<double> reference;             //!< stored reference, not dark-corrected (empty if none)
+            std::vector<double> ratioGain;             //!< 100 / (reference - dark), or 1 / for absorbance
+
+            // combined per-pixel map applied by processFused (empty if identity)
+            std::vector<double> pixelOffset;           //!< dark (or zero)
+            std::vector<double> pixelGain;             //!< ratioGain, ramanIntensityScale (or one)
+
+            // output axis (empty if not resampling): output[k] interpolates 
+            // between pixels resampleIndex[k] and resampleIndex[k] + 1
+            std::vector<int> resampleIndex;
+            std::vector<double> resampleWeight;
+
+            SavitzkyGolay savitzkyGolay;
+            BaselineRemover baselineRemover;
+
+            bool invertX = false;
+            bool badPixelCorrection = true;
+            bool bin2x2 = false;
+            bool ramanIntensityCorrection = false;
+            bool nonlinearityCorrection = false;
+            bool profiling = false;
+            Mode mode = MODE_SCOPE;
+
+            double stageTimeUS[STAGE_COUNT] = { 0 };   //!< cumulative
+            uint64_t stageCalls[STAGE_COUNT] = { 0 };
+
+            template<typename T, bool BIN, bool SCALE, bool LOG> void processFused(T* spectrum);
+            template<typename T> void processProfiled(T* spectrum);
+
+            template<typename T> void correctBadPixels(T* spectrum);
+            template<typename T> void binPixels(T* spectrum);
+            template<typename T> void subtractDark(T* spectrum);
+            template<typename T> void applyRamanIntensity(T* spectrum);
+            template<typename T> void applyRatio(T* spectrum);
+
+            void buildLinearityLUT(const float* coeffs, int count);
+            void rebuildPixelMap();
+    };
+}
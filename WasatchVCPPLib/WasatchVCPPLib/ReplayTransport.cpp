@@ -0,0 +1,150 @@
+/**
+    @file   ReplayTransport.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::ReplayTransport
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "ReplayTransport.h"
+#include "Util.h"
+
+#include <chrono>
+#include <algorithm>
+
+using std::vector;
+using std::string;
+using std::min;
+
+//! @param realTime (Input) whether to reproduce each transfer's recorded duration
+WasatchVCPP::ReplayTransport::ReplayTransport(bool realTime, Logger& logger)
+    : realTime(realTime), logger(logger)
+{
+}
+
+//! @returns false if the capture could not be read (a truncated capture is
+//!          replayed up to the damage)
+bool WasatchVCPP::ReplayTransport::load(const string& pathname)
+{
+    vector<SessionRecorder::Record> records;
+    if (!SessionRecorder::load(pathname, pid, records, logger) && records.empty())
+        return false;
+
+    std::lock_guard<std::mutex> lock(mut);
+    queues.clear();
+    for (auto& r : records)
+    {
+        bool bulk = r.type == SessionRecorder::BULK_IN;
+        Key key(r.type, r.request, bulk ? 0 : r.wValue, bulk ? 0 : r.wIndex);
+        queues[key].records.push_back(std::move(r));
+    }
+
+    logger.info("ReplayTransport: replaying %d transfers (pid 0x%04x%s) from %s", 
+        (int)records.size(), pid, realTime ? ", real-time" : "", pathname.c_str());
+    return true;
+}
+
+int WasatchVCPP::ReplayTransport::getPID() { return pid; }
+
+//! @returns the next recorded transfer for key, or nullptr if there were none (mut held)
+const WasatchVCPP::SessionRecorder::Record* WasatchVCPP::ReplayTransport::take(const Key& key)
+{
+    auto i = queues.find(key);
+    if (i == queues.end())
+        return nullptr;
+
+    Queue& queue = i->second;
+    if (queue.next == queue.records.size())
+    {
+        logger.debug("ReplayTransport: restarting queue of %d transfers (type %d, 0x%02x)", 
+            (int)queue.records.size(), std::get<0>(key), std::get<1>(key));
+        queue.next = 0;
+    }
+    return &queue.records[queue.next++];
+}
+
+//! In real-time mode, block until the record's duration has elapsed since 
+//! startUS (mut held).
+//!
+//! @returns false if interrupted by cancel()
+bool WasatchVCPP::ReplayTransport::wait(std::unique_lock<std::mutex>& lock, const SessionRecorder::Record& record, long long startUS, bool interruptible)
+{
+    if (!realTime)
+        return true;
+
+    const uint64_t cancelled = cancellations;
+    const auto deadline = std::chrono::steady_clock::now() 
+                        + std::chrono::microseconds(startUS + record.durationUS - Util::timestampUS());
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (interruptible && cancellations != cancelled)
+            return false;
+        cv.wait_until(lock, deadline);
+    }
+    return true;
+}
+
+int WasatchVCPP::ReplayTransport::controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* /* data */, int len, int /* timeoutMS */)
+{
+    long long startUS = Util::timestampUS();
+
+    std::unique_lock<std::mutex> lock(mut);
+    auto record = take(Key(SessionRecorder::CONTROL_OUT, bRequest, wValue, wIndex));
+    if (record == nullptr)
+        return len;
+
+    wait(lock, *record, startUS, false);
+    return record->result;
+}
+
+int WasatchVCPP::ReplayTransport::controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int /* timeoutMS */)
+{
+    long long startUS = Util::timestampUS();
+
+    std::unique_lock<std::mutex> lock(mut);
+    auto record = take(Key(SessionRecorder::CONTROL_IN, bRequest, wValue, wIndex));
+    if (record == nullptr)
+    {
+        logger.debug("ReplayTransport: no recorded response to 0x%02x (wValue 0x%04x, wIndex 0x%04x)", bRequest, wValue, wIndex);
+        return ERROR_PIPE;
+    }
+
+    wait(lock, *record, startUS, false);
+    if (record->result < 0)
+        return record->result;
+
+    int n = min(len, (int)record->payload.size());
+    std::copy(record->payload.begin(), record->payload.begin() + n, data);
+    return n;
+}
+
+int WasatchVCPP::ReplayTransport::bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int /* timeoutMS */)
+{
+    long long startUS = Util::timestampUS();
+    *bytesRead = 0;
+
+    std::unique_lock<std::mutex> lock(mut);
+    auto record = take(Key(SessionRecorder::BULK_IN, ep, 0, 0));
+    if (record == nullptr)
+        return ERROR_PIPE;
+
+    if (!wait(lock, *record, startUS, true))
+        return ERROR_INTERRUPTED;
+    if (record->result < 0)
+        return record->result;
+
+    int n = min(len, (int)record->payload.size());
+    std::copy(record->payload.begin(), record->payload.begin() + n, data);
+    *bytesRead = n;
+    return 0;
+}
+
+//! Interrupt any bulk reads currently waiting out their recorded duration.
+void WasatchVCPP::ReplayTransport::cancel()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    cancellations++;
+    cv.notify_all();
+}
+
+bool WasatchVCPP::ReplayTransport::isCancellable() { return true; }
@@ -0,0 +1,75 @@
+/**
+    @file   ReplayTransport.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::ReplayTransport
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include "Transport.h"
+#include "SessionRecorder.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <condition_variable>
+
+namespace WasatchVCPP
+{
+    //! Internal Transport answering from a session captured by 
+    //! SessionRecorder, so that a recorded workload can be re-run 
+    //! deterministically (e.g. to compare driver builds on identical 
+    //! traffic) without the spectrometer which produced it.
+    //!
+    //! Recorded transfers are queued by control opcode (bRequest, wValue,
+    //! wIndex and direction) and by bulk endpoint, and each request is 
+    //! answered by the next transfer in its queue, so the replaying driver 
+    //! needn't interleave opcodes exactly as the recorded one did.  A queue 
+    //! which runs out starts over, so a replay can run longer than its 
+    //! recording.  Control writes never recorded are accepted; control reads 
+    //! and endpoints never recorded stall (ERROR_PIPE).
+    //!
+    //! In real-time mode each transfer takes as long as it originally did;
+    //! otherwise it returns immediately, so the replay measures only the 
+    //! driver's own overhead.
+    class ReplayTransport : public Transport
+    {
+        public:
+            ReplayTransport(bool realTime, Logger& logger);
+
+            bool load(const std::string& pathname);
+            int getPID();
+
+            int controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS);
+            int controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS);
+            int bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS);
+            void cancel();
+            bool isCancellable();
+
+        private:
+            //! type, bRequest (or endpoint), wValue, wIndex
+            typedef std::tuple<uint8_t, uint8_t, uint16_t, uint16_t> Key;
+
+            //! one opcode's (or endpoint's) transfers, in recorded order
+            struct Queue
+            {
+                std::vector<SessionRecorder::Record> records;
+                size_t next = 0;
+            };
+
+            bool realTime;
+            Logger& logger;
+            int pid = 0;
+
+            std::mutex mut;
+            std::condition_variable cv;
+            std::map<Key, Queue> queues;
+            uint64_t cancellations = 0;
+
+            const SessionRecorder::Record* take(const Key& key);
+            bool wait(std::unique_lock<std::mutex>& lock, const SessionRecorder::Record& record, long long startUS, bool interruptible);
+    };
+}
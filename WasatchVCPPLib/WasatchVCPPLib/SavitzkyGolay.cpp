@@ -0,0 +1,223 @@
+/**
+    @file   SavitzkyGolay.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::SavitzkyGolay
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "SavitzkyGolay.h"
+
+#include <cmath>
+#include <algorithm>
+
+using std::vector;
+
+//! Solve the n x n system a * x = b by Gaussian elimination with partial
+//! pivoting (a and b are overwritten).
+//!
+//! @returns false if a is singular
+static bool solveDense(int n, vector<double>& a, vector<double>& b, vector<double>& x)
+{
+    for (int k = 0; k < n; k++)
+    {
+        int pivot = k;
+        for (int i = k + 1; i < n; i++)
+            if (fabs(a[i * n + k]) > fabs(a[pivot * n + k]))
+                pivot = i;
+        if (a[pivot * n + k] == 0)
+            return false;
+        if (pivot != k)
+        {
+            for (int j = 0; j < n; j++)
+                std::swap(a[k * n + j], a[pivot * n + j]);
+            std::swap(b[k], b[pivot]);
+        }
+        for (int i = k + 1; i < n; i++)
+        {
+            double m = a[i * n + k] / a[k * n + k];
+            for (int j = k; j < n; j++)
+                a[i * n + j] -= m * a[k * n + j];
+            b[i] -= m * b[k];
+        }
+    }
+
+    x.resize(n);
+    for (int i = n - 1; i >= 0; i--)
+    {
+        double s = b[i];
+        for (int j = i + 1; j < n; j++)
+            s -= a[i * n + j] * x[j];
+        x[i] = s / a[i * n + i];
+    }
+    return true;
+}
+
+//! Compute the filter's kernels.
+//!
+//! The least-squares polynomial coefficients are (A'A)^-1 A' y, where A is
+//! the Vandermonde matrix of the window's positions t (normalized to 
+//! [-1, 1] to keep A'A well-conditioned).  Its derivative at position t_j 
+//! is v_j' (A'A)^-1 A' y, where v_j holds the derivative of each monomial 
+//! at t_j, so the kernel for position j is A x for (A'A) x = v_j.
+//!
+//! @param halfWidth (Input) pixels either side of center (0 to disable)
+//! @param order (Input) polynomial order (less than the window, up to MAX_ORDER)
+//! @param derivative (Input) 0 to smooth, 1 or more for that derivative (up to order)
+//! @returns false (leaving the filter unchanged) if the parameters are invalid
+bool WasatchVCPP::SavitzkyGolay::configure(int halfWidth, int order, int derivative)
+{
+    if (halfWidth == 0)
+    {
+        this->halfWidth = 0;
+        kernels.clear();
+        return true;
+    }
+
+    const int window = 2 * halfWidth + 1;
+    if (halfWidth < 0 || order < 0 || order > MAX_ORDER || order >= window || derivative < 0 || derivative > order)
+        return false;
+
+    const int terms = order + 1;
+    const double scale = 1 / pow((double)halfWidth, derivative); // d/dt to per-pixel
+
+    vector<double> vandermonde(window * terms);
+    for (int i = 0; i < window; i++)
+    {
+        double t = (double)(i - halfWidth) / halfWidth;
+        double power = 1;
+        for (int c = 0; c < terms; c++, power *= t)
+            vandermonde[i * terms + c] = power;
+    }
+
+    vector<double> gram(terms * terms, 0);
+    for (int r = 0; r < terms; r++)
+        for (int c = 0; c < terms; c++)
+            for (int i = 0; i < window; i++)
+                gram[r * terms + c] += vandermonde[i * terms + r] * vandermonde[i * terms + c];
+
+    vector<double> k(window * window);
+    vector<double> a, v, x;
+    for (int j = 0; j < window; j++)
+    {
+        // d^n/dt^n of t^c at t_j is c! / (c - n)! * t_j^(c - n)
+        double t = (double)(j - halfWidth) / halfWidth;
+        v.assign(terms, 0);
+        for (int c = derivative; c < terms; c++)
+        {
+            double coeff = 1;
+            for (int q = 0; q < derivative; q++)
+                coeff *= c - q;
+            v[c] = coeff * pow(t, c - derivative);
+        }
+
+        a = gram;
+        if (!solveDense(terms, a, v, x))
+            return false;
+
+        for (int i = 0; i < window; i++)
+        {
+            double sum = 0;
+            for (int c = 0; c < terms; c++)
+                sum += x[c] * vandermonde[i * terms + c];
+            k[j * window + i] = scale * sum;
+        }
+    }
+
+    this->halfWidth = halfWidth;
+    this->order = order;
+    this->derivative = derivative;
+    kernels.swap(k);
+    return true;
+}
+
+bool WasatchVCPP::SavitzkyGolay::isEnabled()
+{
+    return halfWidth > 0;
+}
+
+//! @returns the window width in pixels (0 if disabled)
+int WasatchVCPP::SavitzkyGolay::getWindow()
+{
+    return halfWidth > 0 ? 2 * halfWidth + 1 : 0;
+}
+
+//! Filter a spectrum in-place (spectra shorter than the window are unchanged).
+template<typename T>
+void WasatchVCPP::SavitzkyGolay::apply(T* spectrum, int pixels)
+{
+    if (halfWidth == 0 || pixels < getWindow())
+        return;
+
+    input.resize(pixels);
+    for (int i = 0; i < pixels; i++)
+        input[i] = spectrum[i];
+    convolve(input.data(), spectrum, pixels);
+}
+
+//! Filter 'input' into 'output', which must not overlap.
+//!
+//! The interior computes four adjacent outputs per pass over the kernel, 
+//! in independent accumulators which the compiler can pack into SIMD 
+//! registers (each tap's coefficient is broadcast against four contiguous
+//! inputs).  Every output still sums its taps in order, so results match
+//! the plain convolution exactly.
+template<typename T>
+void WasatchVCPP::SavitzkyGolay::convolve(const double* input, T* output, int pixels)
+{
+    const int window = getWindow();
+    if (window == 0 || pixels < window)
+        return;
+
+    // interior
+    const double* interior = kernels.data() + halfWidth * window;
+    const int count = pixels - window + 1;
+    T* dest = output + halfWidth;
+    int i = 0;
+    for ( ; i + 4 <= count; i += 4)
+    {
+        const double* src = input + i;
+        double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+        for (int tap = 0; tap < window; tap++)
+        {
+            const double c = interior[tap];
+            a0 += c * src[tap];
+            a1 += c * src[tap + 1];
+            a2 += c * src[tap + 2];
+            a3 += c * src[tap + 3];
+        }
+        dest[i]     = (T)a0;
+        dest[i + 1] = (T)a1;
+        dest[i + 2] = (T)a2;
+        dest[i + 3] = (T)a3;
+    }
+    for ( ; i < count; i++)
+    {
+        double a = 0;
+        for (int tap = 0; tap < window; tap++)
+            a += interior[tap] * input[i + tap];
+        dest[i] = (T)a;
+    }
+
+    // edges, evaluated off-center within the first and last windows
+    for (int j = 0; j < halfWidth; j++)
+    {
+        const double* left = kernels.data() + j * window;
+        const double* right = kernels.data() + (window - 1 - j) * window;
+        const double* tail = input + pixels - window;
+        double sumLeft = 0;
+        double sumRight = 0;
+        for (int i = 0; i < window; i++)
+        {
+            sumLeft += left[i] * input[i];
+            sumRight += right[i] * tail[i];
+        }
+        output[j] = (T)sumLeft;
+        output[pixels - 1 - j] = (T)sumRight;
+    }
+}
+
+// instantiate for ProcessingPipeline::process and wp_savitzky_golay
+template void WasatchVCPP::SavitzkyGolay::apply<double>(double* spectrum, int pixels);
+template void WasatchVCPP::SavitzkyGolay::apply<float>(float* spectrum, int pixels);
+template void WasatchVCPP::SavitzkyGolay::convolve<double>(const double* input, double* output, int pixels);
@@ -0,0 +1,49 @@
+/**
+    @file   SavitzkyGolay.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::SavitzkyGolay
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <vector>
+
+namespace WasatchVCPP
+{
+    //! Internal class applying a Savitzky-Golay smoothing or derivative
+    //! filter.
+    //!
+    //! Each output pixel is the given derivative (per pixel), at that pixel,
+    //! of a least-squares polynomial fit to the surrounding window.  For
+    //! interior pixels that is a fixed convolution; within halfWidth of
+    //! either end, the polynomial fit to the first (or last) full window is
+    //! evaluated off-center instead, so edges are neither truncated nor
+    //! padded.  All 2 * halfWidth + 1 kernels are computed once by
+    //! configure().  Order 0 is a boxcar (moving average).
+    //!
+    //! Not internally synchronized (ProcessingPipeline serializes access).
+    class SavitzkyGolay
+    {
+        public:
+            static const int MAX_ORDER = 10;
+
+            bool configure(int halfWidth, int order, int derivative);
+            bool isEnabled();
+            int getWindow();
+
+            template<typename T> void apply(T* spectrum, int pixels);
+            template<typename T> void convolve(const double* input, T* output, int pixels);
+
+        private:
+            int halfWidth = 0;              //!< 0 if disabled
+            int order = 0;
+            int derivative = 0;
+
+            //! kernels[j * window + i] weights window point i when evaluating
+            //! at window position j (j == halfWidth being the interior kernel)
+            std::vector<double> kernels;
+
+            std::vector<double> input;      //!< copy of the spectrum being filtered in-place
+    };
+}
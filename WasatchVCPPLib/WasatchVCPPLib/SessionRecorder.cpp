@@ -0,0 +1,178 @@
+/**
+    @file   SessionRecorder.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::SessionRecorder
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "SessionRecorder.h"
+#include "Util.h"
+
+#include <cstring>
+
+using std::vector;
+using std::string;
+
+static const char MAGIC[4] = { 'W', 'P', 'U', 'C' };
+static const int HEADER_LEN = 7;
+static const int RECORD_HEADER_LEN = 26;
+
+static void putLE(vector<uint8_t>& buf, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        buf.push_back((value >> (8 * i)) & 0xff);
+}
+
+static uint64_t getLE(const uint8_t* data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)data[i] << (8 * i);
+    return value;
+}
+
+WasatchVCPP::SessionRecorder::SessionRecorder(Logger& logger)
+    : logger(logger)
+{
+}
+
+WasatchVCPP::SessionRecorder::~SessionRecorder()
+{
+    close();
+}
+
+//! Create (or truncate) the capture file and write its header; the 
+//! session's relative timestamps start from here.
+bool WasatchVCPP::SessionRecorder::open(const string& pathname, int pid)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    if (file.is_open())
+        return false;
+
+    file.open(pathname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        logger.error("SessionRecorder: unable to create %s", pathname.c_str());
+        return false;
+    }
+
+    buf.assign(MAGIC, MAGIC + sizeof(MAGIC));
+    putLE(buf, FORMAT_VERSION, 1);
+    putLE(buf, pid, 2);
+    file.write((const char*)buf.data(), buf.size());
+
+    sessionStartUS = Util::timestampUS();
+    records = 0;
+    logger.info("SessionRecorder: recording pid 0x%04x to %s", pid, pathname.c_str());
+    return true;
+}
+
+void WasatchVCPP::SessionRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    if (!file.is_open())
+        return;
+
+    file.close();
+    logger.info("SessionRecorder: closed after %llu records", (unsigned long long)records);
+}
+
+//! Append one completed transfer (ignored if not open).
+//!
+//! @param startUS (Input) Util::timestampUS when the transfer began (its 
+//!        duration runs from then until now)
+//! @param payload (Input) bytes written or read (may be null if len is 0)
+void WasatchVCPP::SessionRecorder::record(Type type, uint8_t request, uint16_t wValue, uint16_t wIndex, 
+    int result, long long startUS, const uint8_t* payload, int len)
+{
+    long long endUS = Util::timestampUS();
+    if (payload == nullptr || len < 0)
+        len = 0;
+
+    std::lock_guard<std::mutex> lock(mut);
+    if (!file.is_open())
+        return;
+
+    long long relativeUS = startUS - sessionStartUS;
+    long long durationUS = endUS - startUS;
+
+    buf.clear();
+    putLE(buf, type, 1);
+    putLE(buf, request, 1);
+    putLE(buf, wValue, 2);
+    putLE(buf, wIndex, 2);
+    putLE(buf, (uint32_t)result, 4);
+    putLE(buf, relativeUS > 0 ? relativeUS : 0, 8);
+    putLE(buf, durationUS > 0xffffffffLL ? 0xffffffffLL : (durationUS > 0 ? durationUS : 0), 4);
+    putLE(buf, len, 4);
+    buf.insert(buf.end(), payload, payload + len);
+
+    if (!file.write((const char*)buf.data(), buf.size()))
+    {
+        logger.error("SessionRecorder: write failed, recording stopped");
+        file.close();
+        return;
+    }
+    records++;
+}
+
+//! Read a capture file written by a SessionRecorder.
+//!
+//! @param pid (Output) the recorded spectrometer's PID
+//! @param records (Output) transfers in recorded order
+//! @returns false if the file is missing, truncated or not a capture
+bool WasatchVCPP::SessionRecorder::load(const string& pathname, int& pid, vector<Record>& records, Logger& logger)
+{
+    records.clear();
+
+    std::ifstream f(pathname, std::ios::in | std::ios::binary);
+    if (!f.is_open())
+    {
+        logger.error("SessionRecorder::load: unable to open %s", pathname.c_str());
+        return false;
+    }
+
+    uint8_t header[RECORD_HEADER_LEN];
+    if (!f.read((char*)header, HEADER_LEN) || memcmp(header, MAGIC, sizeof(MAGIC)) || header[4] != FORMAT_VERSION)
+    {
+        logger.error("SessionRecorder::load: %s is not a version %d capture", pathname.c_str(), FORMAT_VERSION);
+        return false;
+    }
+    pid = (int)getLE(header + 5, 2);
+
+    bool ok = true;
+    while (true)
+    {
+        f.read((char*)header, RECORD_HEADER_LEN);
+        std::streamsize n = f.gcount();
+        if (n == 0)
+            break;
+
+        Record r;
+        uint32_t len = 0;
+        if (n == RECORD_HEADER_LEN)
+        {
+            r.type       = header[0];
+            r.request    = header[1];
+            r.wValue     = (uint16_t)getLE(header + 2, 2);
+            r.wIndex     = (uint16_t)getLE(header + 4, 2);
+            r.result     = (int32_t)(uint32_t)getLE(header + 6, 4);
+            r.startUS    = getLE(header + 10, 8);
+            r.durationUS = (uint32_t)getLE(header + 18, 4);
+            len          = (uint32_t)getLE(header + 22, 4);
+            r.payload.resize(len);
+        }
+        if (n != RECORD_HEADER_LEN || r.type < CONTROL_OUT || r.type > BULK_IN || 
+            (len > 0 && !f.read((char*)r.payload.data(), len)))
+        {
+            logger.error("SessionRecorder::load: %s truncated or corrupt after %d records", pathname.c_str(), (int)records.size());
+            ok = false;
+            break;
+        }
+        records.push_back(std::move(r));
+    }
+
+    logger.debug("SessionRecorder::load: read %d records (pid 0x%04x) from %s", (int)records.size(), pid, pathname.c_str());
+    return ok;
+}
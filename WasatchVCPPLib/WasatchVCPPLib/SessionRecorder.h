@@ -0,0 +1,83 @@
+/**
+    @file   SessionRecorder.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::SessionRecorder
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include "Logger.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+
+namespace WasatchVCPP
+{
+    //! Internal class capturing every USB transfer a Spectrometer makes 
+    //! (sendCmd, getCmdReal and getSubspectrum) to a compact binary file,
+    //! which ReplayTransport can later feed back to a Spectrometer.
+    //!
+    //! The file is a header ("WPUC", format version byte, little-endian 
+    //! uint16 PID) followed by one record per transfer, in completion order:
+    //!
+    //! - uint8 type (Type)
+    //! - uint8 bRequest (or bulk endpoint)
+    //! - uint16 wValue, uint16 wIndex (0 for bulk)
+    //! - int32 result (control: bytes transferred or error; bulk: 0 or error)
+    //! - uint64 start, in microseconds since the recording began
+    //! - uint32 duration in microseconds
+    //! - uint32 payload length, then the payload (bytes written or read)
+    //!
+    //! All fields are little-endian.  A bulk record holds one whole 
+    //! subspectrum, however many transfers it took.
+    //!
+    //! Internally synchronized (endpoints are read from several threads).
+    class SessionRecorder
+    {
+        public:
+            enum Type
+            {
+                CONTROL_OUT = 1,
+                CONTROL_IN = 2,
+                BULK_IN = 3
+            };
+
+            struct Record
+            {
+                uint8_t type = 0;
+                uint8_t request = 0;
+                uint16_t wValue = 0;
+                uint16_t wIndex = 0;
+                int32_t result = 0;
+                uint64_t startUS = 0;
+                uint32_t durationUS = 0;
+                std::vector<uint8_t> payload;
+            };
+
+            static const int FORMAT_VERSION = 1;
+
+            SessionRecorder(Logger& logger);
+            ~SessionRecorder();
+
+            bool open(const std::string& pathname, int pid);
+            void close();
+
+            void record(Type type, uint8_t request, uint16_t wValue, uint16_t wIndex, 
+                int result, long long startUS, const uint8_t* payload, int len);
+
+            static bool load(const std::string& pathname, int& pid, std::vector<Record>& records, Logger& logger);
+
+        private:
+            Logger& logger;
+
+            std::mutex mut;
+            std::ofstream file;
+            long long sessionStartUS = 0;   //!< Util::timestampUS
+            uint64_t records = 0;
+            std::vector<uint8_t> buf;       //!< serialized record
+    };
+}
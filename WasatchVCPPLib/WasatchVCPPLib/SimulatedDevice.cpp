@@ -0,0 +1,405 @@
+/**
+    @file   SimulatedDevice.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::SimulatedDevice
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "SimulatedDevice.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using std::vector;
+using std::string;
+using std::min;
+using std::max;
+
+//! getters which echo a setter's value, and how many bytes they return
+struct Echo
+{
+    uint8_t getter;
+    uint8_t setter;
+    int len;
+};
+
+static const Echo echoes[] =
+{
+    { 0xbf, 0xb2, 3 },  // integration time (24-bit)
+    { 0xc5, 0xb7, 2 },  // detector gain
+    { 0x9f, 0x9d, 2 },  // detector gain (odd)
+    { 0xc4, 0xb6, 2 },  // detector offset
+    { 0x9e, 0x9c, 2 },  // detector offset (odd)
+    { 0xe2, 0xbe, 1 },  // laser enable
+    { 0xe3, 0xbd, 1 },  // laser modulation enable
+    { 0xcb, 0xc7, 5 },  // laser modulation period (40-bit)
+    { 0xda, 0xd6, 1 },  // detector TEC enable
+    { 0xec, 0xeb, 1 },  // high-gain mode
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// EEPROM image
+////////////////////////////////////////////////////////////////////////////////
+
+static void putUInt16(vector<uint8_t>& page, int index, uint16_t value)
+{
+    page[index]     = value & 0xff;
+    page[index + 1] = value >> 8;
+}
+
+static void putUInt32(vector<uint8_t>& page, int index, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        page[index + i] = (value >> (8 * i)) & 0xff;
+}
+
+static void putFloat(vector<uint8_t>& page, int index, float value)
+{
+    uint32_t raw = 0;
+    memcpy(&raw, &value, sizeof(raw));
+    putUInt32(page, index, raw);
+}
+
+static void putString(vector<uint8_t>& page, int index, int len, const string& value)
+{
+    for (int i = 0; i < len; i++)
+        page[index + i] = i < (int)value.size() ? (uint8_t)value[i] : 0;
+}
+
+//! A format 9 EEPROM describing a cooled 785nm Raman spectrometer (offsets
+//! as parsed by EEPROM::parse).
+//!
+//! The TEC and thermistor calibrations are linear, so the simulation can 
+//! invert them to report the detector at its setpoint.
+vector<vector<uint8_t> > WasatchVCPP::SimulatedDevice::defaultEEPROM(const string& serialNumber, int pixels)
+{
+    vector<vector<uint8_t> > pages(EEPROM::MAX_PAGES, vector<uint8_t>(EEPROM::PAGE_SIZE, 0));
+
+    auto& p0 = pages[0];
+    putString(p0, 0, 16, "WP-785X-SIM");
+    putString(p0, 16, 16, serialNumber);
+    p0[36] = 1;                             // hasCooling
+    p0[38] = 1;                             // hasLaser
+    putUInt16(p0, 39, 0);                   // feature mask
+    putUInt16(p0, 41, 50);                  // slit width
+    putUInt16(p0, 43, 100);                 // startup integration time
+    putUInt16(p0, 45, 10);                  // startup detector temperature
+    putFloat (p0, 48, 1.9f);                // detector gain
+    putFloat (p0, 54, 1.9f);                // detector gain (odd)
+    p0[63] = 9;                             // format
+
+    auto& p1 = pages[1];
+    putFloat (p1, 0, 790.0f);               // wavecal
+    putFloat (p1, 4, 0.25f);
+    putFloat (p1, 8, -1e-5f);
+    putFloat (p1, 16, 2000.0f);             // degC to TEC DAC
+    putFloat (p1, 20, -100.0f);
+    putUInt16(p1, 28, 20);                  // max detector temperature
+    putUInt16(p1, 30, (uint16_t)-15);       // min detector temperature
+    putFloat (p1, 32, -50.0f);              // thermistor ADC to degC
+    putFloat (p1, 36, 0.025f);
+    putString(p1, 48, 12, "2026-01-01");
+    putString(p1, 60, 3, "SIM");
+
+    auto& p2 = pages[2];
+    putString(p2, 0, 16, "SIMULATED");
+    putUInt16(p2, 16, (uint16_t)pixels);    // active pixels (horizontal)
+    putUInt16(p2, 19, 64);                  // active pixels (vertical)
+    putUInt16(p2, 25, (uint16_t)pixels);    // actual pixels (horizontal)
+    putUInt16(p2, 29, (uint16_t)(pixels - 1));
+
+    auto& p3 = pages[3];
+    putFloat (p3, 28, 100.0f);              // max laser power
+    putFloat (p3, 36, 785.0f);              // excitation
+    putUInt32(p3, 40, 1);                   // min integration time
+    putUInt32(p3, 44, 60000);               // max integration time
+    putFloat (p3, 48, 10.0f);               // average resolution
+
+    putString(pages[4], 0, 64, "simulated spectrometer");
+
+    auto& p5 = pages[5];
+    for (int i = 0; i < 15; i++)
+        putUInt16(p5, i * 2, 0xffff);       // no bad pixels
+    putString(p5, 30, 16, "SIM");
+
+    return pages;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Lifecycle
+////////////////////////////////////////////////////////////////////////////////
+
+WasatchVCPP::SimulatedDevice::SimulatedDevice(const Config& config, Logger& logger)
+    : config(config), logger(logger), eeprom(logger), rng(config.seed)
+{
+    auto& pages = this->config.eepromPages;
+    if (pages.empty())
+        pages = defaultEEPROM("SIM-0000");
+    pages.resize(EEPROM::MAX_PAGES);
+    for (auto& page : pages)
+        page.resize(EEPROM::PAGE_SIZE, 0);
+
+    eeprom.parse(pages);
+    pixels = eeprom.activePixelsHoriz;
+
+    // lay out endpoints as Spectrometer expects to read them
+    if (pixels == 2048 && config.pid != 0x4000)
+    {
+        endpoints.resize(2);
+        endpoints[1].address = 0x86;
+        endpoints[1].firstPixel = 1024;
+    }
+    else
+        endpoints.resize(1);
+    endpoints[0].address = 0x82;
+    for (size_t e = 0; e < endpoints.size(); e++)
+    {
+        auto& endpoint = endpoints[e];
+        endpoint.pixels = (e + 1 < endpoints.size() ? endpoints[e + 1].firstPixel : pixels) - endpoint.firstPixel;
+        endpoint.data.reserve(MAX_QUEUED_SPECTRA * 2 * (size_t)endpoint.pixels);
+    }
+    pending.reserve(2 * MAX_QUEUED_SPECTRA);
+
+    // fixed-pattern dark current, a few weak emission lines (stray light), 
+    // and stronger Raman lines on a broad fluorescence hump
+    const double emission[][2] = { { 0.12, 6 }, { 0.37, 15 }, { 0.58, 4 }, { 0.83, 9 } };
+    const double raman[][2] = { { 0.18, 40 }, { 0.26, 25 }, { 0.33, 90 }, { 0.47, 60 }, 
+                                { 0.55, 30 }, { 0.66, 120 }, { 0.74, 20 }, { 0.91, 45 } };
+    darkPerMS.resize(pixels);
+    emissionPerMS.resize(pixels);
+    ramanPerMS.resize(pixels);
+    frame.resize(pixels);
+    for (int i = 0; i < pixels; i++)
+    {
+        double x = (double)i / max(1, pixels - 1);
+        darkPerMS[i] = 0.5 + 0.1 * sin(i * 0.37);
+
+        double e = 0;
+        for (const auto& line : emission)
+            e += line[1] * exp(-0.5 * pow((x - line[0]) * pixels / 2.5, 2));
+        emissionPerMS[i] = e;
+
+        double r = 10 * exp(-0.5 * pow((x - 0.5) / 0.3, 2));
+        for (const auto& line : raman)
+            r += line[1] * exp(-0.5 * pow((x - line[0]) * pixels / 3.0, 2));
+        ramanPerMS[i] = r;
+    }
+
+    logger.debug("SimulatedDevice: %s (pid 0x%04x, %d pixels, latency scale %.2f)", 
+        eeprom.serialNumber.c_str(), config.pid, pixels, config.latencyScale);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Transport
+////////////////////////////////////////////////////////////////////////////////
+
+int WasatchVCPP::SimulatedDevice::controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int /* timeoutMS */)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    Clock::time_point now = Clock::now();
+
+    uint64_t value = wValue | ((uint64_t)wIndex << 16);
+    if (len > 0 && data != nullptr)
+        value |= (uint64_t)data[0] << 32;
+    registers[bRequest] = value;
+
+    switch (bRequest)
+    {
+        case 0xad: // ACQUIRE
+            queueAcquisition(now);
+            cv.notify_all();
+            break;
+
+        case 0xb2: // integration time
+        {
+            integrationTimeMS = (uint32_t)(value & 0xffffff);
+
+            // as with the FPGA, shortening the integration in progress ends
+            // it early (this is how cancelOperation works)
+            Clock::time_point end = now + std::chrono::milliseconds(integrationTimeMS);
+            if (!pending.empty() && pending.front() > end)
+                pending.front() = end;
+            break;
+        }
+
+        case 0xd2: // trigger source
+            externalTrigger = wValue != 0;
+            break;
+
+        default:
+            break;
+    }
+    return len;
+}
+
+int WasatchVCPP::SimulatedDevice::controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int /* timeoutMS */)
+{
+    std::lock_guard<std::mutex> lock(mut);
+
+    vector<uint8_t> response;
+    if (bRequest == 0xff && wValue == 0x01 && wIndex < EEPROM::MAX_PAGES)
+        response = config.eepromPages[wIndex];
+    else if (bRequest == 0xc0)
+        response = { 0, 0, 0, 1 };      // firmware 1.0.0.0
+    else if (bRequest == 0xb4)
+        response = { 'S', 'I', 'M', '-', '1', '.', '0' };
+    else if (bRequest == 0xd7)
+    {
+        uint16_t raw = getDetectorTemperatureRaw();
+        response = { (uint8_t)(raw >> 8), (uint8_t)(raw & 0xff) }; // MSB-LSB
+    }
+    else
+    {
+        for (const auto& echo : echoes)
+        {
+            if (echo.getter != bRequest)
+                continue;
+
+            uint64_t value = echo.setter == 0xb2 ? integrationTimeMS : registers[echo.setter];
+            for (int i = 0; i < echo.len; i++)
+                response.push_back((value >> (8 * i)) & 0xff);
+            break;
+        }
+    }
+
+    if (response.empty())
+    {
+        logger.debug("SimulatedDevice: unsupported getter 0x%02x (wValue 0x%04x)", bRequest, wValue);
+        return ERROR_PIPE;
+    }
+
+    memset(data, 0, len);
+    memcpy(data, response.data(), min(len, (int)response.size()));
+    return len;
+}
+
+int WasatchVCPP::SimulatedDevice::bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS)
+{
+    *bytesRead = 0;
+
+    std::unique_lock<std::mutex> lock(mut);
+    Endpoint* endpoint = nullptr;
+    for (auto& e : endpoints)
+        if (e.address == ep)
+            endpoint = &e;
+    if (endpoint == nullptr)
+        return ERROR_PIPE;
+
+    const uint64_t cancelled = cancellations;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMS);
+    while (true)
+    {
+        Clock::time_point now = Clock::now();
+        deliverCompleted(now);
+
+        if (!endpoint->data.empty())
+        {
+            int n = min(len, (int)endpoint->data.size());
+            std::copy(endpoint->data.begin(), endpoint->data.begin() + n, data);
+            endpoint->data.erase(endpoint->data.begin(), endpoint->data.begin() + n);
+            *bytesRead = n;
+            return 0;
+        }
+
+        if (cancellations != cancelled)
+            return ERROR_INTERRUPTED;
+        if (timeoutMS > 0 && now >= deadline)
+            return ERROR_TIMEOUT;
+
+        if (externalTrigger && pending.empty())
+            queueAcquisition(now);
+
+        if (pending.empty())
+        {
+            if (timeoutMS > 0)
+                cv.wait_until(lock, deadline);
+            else
+                cv.wait(lock);
+        }
+        else
+            cv.wait_until(lock, timeoutMS > 0 ? min(deadline, pending.front()) : pending.front());
+    }
+}
+
+//! Interrupt any bulk reads currently waiting.
+void WasatchVCPP::SimulatedDevice::cancel()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    cancellations++;
+    cv.notify_all();
+}
+
+bool WasatchVCPP::SimulatedDevice::isCancellable() { return true; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulation (mut held)
+////////////////////////////////////////////////////////////////////////////////
+
+//! integrations run back-to-back, so each starts when the last ends
+void WasatchVCPP::SimulatedDevice::queueAcquisition(Clock::time_point now)
+{
+    Clock::time_point start = pending.empty() ? now : max(now, pending.back());
+    long long us = llround(config.latencyScale * integrationTimeMS * 1000) + config.readoutUS;
+    pending.push_back(start + std::chrono::microseconds(max(0LL, us)));
+}
+
+void WasatchVCPP::SimulatedDevice::deliverCompleted(Clock::time_point now)
+{
+    bool delivered = false;
+    while (!pending.empty() && pending.front() <= now)
+    {
+        pending.erase(pending.begin());
+        generate();
+        delivered = true;
+    }
+    if (delivered)
+        cv.notify_all();
+}
+
+//! Synthesize one spectrum onto the endpoint(s), discarding the oldest if
+//! too many are left unread (as the FPGA's FIFO would overflow).
+void WasatchVCPP::SimulatedDevice::generate()
+{
+    const double baseline = 800;
+    const double readNoise = 8;
+
+    std::normal_distribution<double> noise(0, 1);
+    bool laser = registers[0xbe] != 0;
+    for (int i = 0; i < pixels; i++)
+    {
+        double signal = integrationTimeMS * (darkPerMS[i] + emissionPerMS[i] + (laser ? ramanPerMS[i] : 0));
+        double value = baseline + signal + noise(rng) * (sqrt(signal) + readNoise);
+        frame[i] = (uint16_t)max(0.0, min(65535.0, value));
+    }
+
+    for (auto& endpoint : endpoints)
+    {
+        size_t bytes = 2 * (size_t)endpoint.pixels;
+        if (endpoint.data.size() >= MAX_QUEUED_SPECTRA * bytes)
+            endpoint.data.erase(endpoint.data.begin(), endpoint.data.begin() + bytes);
+        for (int i = 0; i < endpoint.pixels; i++)
+        {
+            uint16_t pixel = frame[endpoint.firstPixel + i];
+            endpoint.data.push_back(pixel & 0xff);  // little-endian
+            endpoint.data.push_back(pixel >> 8);
+        }
+    }
+}
+
+//! At the TEC setpoint if enabled, otherwise ambient (25C), inverting the
+//! EEPROM's (linear) calibrations.
+uint16_t WasatchVCPP::SimulatedDevice::getDetectorTemperatureRaw()
+{
+    double degC = 25;
+    const float* dac = eeprom.degCToDACCoeffs;
+    if (registers[0xd6] != 0 && registers.count(0xd8) && dac[1] != 0)
+        degC = ((registers[0xd8] & 0xfff) - dac[0]) / dac[1];
+
+    const float* adc = eeprom.adcToDegCCoeffs;
+    if (adc[1] == 0)
+        return 0;
+    double raw = (degC - adc[0]) / adc[1];
+    return (uint16_t)max(0.0, min(65535.0, raw + 0.5));
+}
@@ -0,0 +1,106 @@
+/**
+    @file   SimulatedDevice.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::SimulatedDevice
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include "Transport.h"
+#include "EEPROM.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <condition_variable>
+
+namespace WasatchVCPP
+{
+    //! Internal in-process stand-in for a spectrometer, answering opcodes
+    //! and producing synthetic spectra, for testing and benchmarking 
+    //! without hardware.
+    //!
+    //! Setters are remembered and echoed by their getters (integration 
+    //! time, gain, offset, laser, TEC, etc); EEPROM pages, firmware and FPGA
+    //! versions and detector temperature are answered from the configured
+    //! EEPROM image; unknown opcodes stall (ERROR_PIPE).
+    //!
+    //! Each ACQUIRE (0xad) queues an integration behind any already queued,
+    //! completing latencyScale * integration time later (plus a fixed
+    //! readout), whereupon its pixels appear on the bulk endpoint(s) laid 
+    //! out as the real device would (two endpoints for 2048-pixel FX2 
+    //! units).  In external trigger mode (0xd2), the simulated trigger 
+    //! fires continuously while a read is waiting.
+    //!
+    //! Spectra are a dark baseline plus emission peaks (and Raman peaks 
+    //! while the laser is enabled), scaled by integration time, with shot 
+    //! and read noise.
+    class SimulatedDevice : public Transport
+    {
+        public:
+            struct Config
+            {
+                int pid = 0x1000;
+                std::vector<std::vector<uint8_t> > eepromPages; //!< empty for defaultEEPROM()
+                double latencyScale = 1.0;  //!< fraction of each integration actually waited (0 for no delay)
+                int readoutUS = 0;          //!< added to each acquisition
+                unsigned seed = 0;          //!< noise
+            };
+
+            SimulatedDevice(const Config& config, Logger& logger);
+
+            int controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS);
+            int controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS);
+            int bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS);
+            void cancel();
+            bool isCancellable();
+
+            static std::vector<std::vector<uint8_t> > defaultEEPROM(const std::string& serialNumber, int pixels = 1024);
+
+        private:
+            typedef std::chrono::steady_clock Clock;
+
+            //! spectra left unread beyond this are discarded (oldest first)
+            static const int MAX_QUEUED_SPECTRA = 8;
+
+            //! bytes pending on one bulk endpoint (storage is reserved up 
+            //! front, so steady-state acquisition doesn't allocate)
+            struct Endpoint
+            {
+                uint8_t address = 0;
+                int firstPixel = 0;
+                int pixels = 0;
+                std::vector<uint8_t> data;
+            };
+
+            Config config;
+            Logger& logger;
+            EEPROM eeprom;
+            int pixels = 0;
+
+            std::mutex mut;
+            std::condition_variable cv;
+
+            std::vector<Endpoint> endpoints;
+            std::map<uint8_t, uint64_t> registers;  //!< last value written, by setter opcode
+            uint32_t integrationTimeMS = 1;
+            bool externalTrigger = false;
+            std::vector<Clock::time_point> pending; //!< queued integrations, by completion time
+            uint64_t cancellations = 0;
+
+            std::mt19937 rng;
+            std::vector<double> darkPerMS;          //!< counts per ms of integration, by pixel
+            std::vector<double> emissionPerMS;
+            std::vector<double> ramanPerMS;
+            std::vector<uint16_t> frame;
+
+            void queueAcquisition(Clock::time_point now);
+            void deliverCompleted(Clock::time_point now);
+            void generate();
+            uint16_t getDetectorTemperatureRaw();
+    };
+}
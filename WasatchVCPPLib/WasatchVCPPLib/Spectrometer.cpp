@@ -9,12 +9,14 @@
 #include "pch.h"
 #include "Driver.h"
 #include "Spectrometer.h"
+#include "AsyncBulkReader.h"
 #include "ParseData.h"
 #include "Uint40.h"
 #include "Util.h"
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <algorithm>
 #include <chrono>
@@ -32,19 +34,27 @@ using std::min;
 // Constants
 ////////////////////////////////////////////////////////////////////////////////
 
-const int HOST_TO_DEVICE = 0x40;
-const int DEVICE_TO_HOST = 0xC0;
-
 const int MIN_ARM_LEN = 8;
 
 unsigned long MAX_UINT24 = 16777216;
 
+//! set on every callbackThread (so spectrum callbacks can't stop themselves)
+static thread_local bool inSpectrumCallback = false;
+
+//! native-resolution spectra awaiting resampling onto an output axis, per 
+//! acquiring thread (grown to the largest detector it has read, so not
+//! reallocated in steady state)
+static thread_local std::vector<double> resampleInput;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Lifecycle
 ////////////////////////////////////////////////////////////////////////////////
 
-WasatchVCPP::Spectrometer::Spectrometer(WPVCPP_UDEV_TYPE* udev, int pid, int index, Logger& logger)
-    : udev(udev), pid(pid), index(index), logger(logger), eeprom(logger)
+//! @param transport (Input) the device's USB transfers (owned from here on)
+//! @param recorder (Input) if non-null, an open SessionRecorder capturing 
+//!        every transfer from construction onward (owned from here on)
+WasatchVCPP::Spectrometer::Spectrometer(Transport* transport, int pid, int index, Logger& logger, SessionRecorder* recorder)
+    : eeprom(logger), pid(pid), index(index), transport(transport), recorder(recorder), logger(logger)
 {
 
     logger.debug("Spectrometer::ctor: instantiating index %d (pid 0x%04x)", index, pid);
@@ -67,6 +77,7 @@ WasatchVCPP::Spectrometer::Spectrometer(WPVCPP_UDEV_TYPE* udev, int pid, int ind
     ////////////////////////////////////////////////////////////////////////////
 
     pixels = eeprom.activePixelsHoriz;
+    pipeline.init(eeprom, ramanIntensityFactors);
 
     wavelengths.resize(pixels);
     for (int i = 0; i < pixels; i++)
@@ -127,7 +138,13 @@ WasatchVCPP::Spectrometer::Spectrometer(WPVCPP_UDEV_TYPE* udev, int pid, int ind
         endpoints.push_back(0x86);
         pixelsPerEndpoint = 1024;
     }
-    bufSubspectrum.resize(pixelsPerEndpoint * 2);
+    bufSubspectra.resize(endpoints.size());
+    for (auto& buf : bufSubspectra)
+        buf.resize(pixelsPerEndpoint * 2);
+
+    // additional endpoints are read in parallel with the first
+    if (endpoints.size() > 1)
+        endpointThread = std::thread(&Spectrometer::endpointLoop, this);
 
     if (isInGaAs())
         setHighGainModeEnable(true);
@@ -144,17 +161,28 @@ WasatchVCPP::Spectrometer::~Spectrometer()
 bool WasatchVCPP::Spectrometer::close()
 {
     logger.info("Spectrometer::close");
-    if (udev != nullptr)
+    stopContinuous();
+    if (endpointThread.joinable())
     {
-#if USE_LIBUSB_WIN32
-        usb_release_interface(udev, 0);
-        usb_close(udev);
-#else
-        logger.info("Spectrometer::close releasing interface on Linux");
-        libusb_release_interface(udev, 0);
-        libusb_close(udev);
-#endif
-        udev = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutEndpoint);
+            endpointThreadExit = true;
+        }
+        cvEndpoint.notify_all();
+        endpointThread.join();
+    }
+    if (transport != nullptr)
+    {
+        // in-flight transfers must be reaped before the handle goes away
+        setAsyncBulkTransfers(0);
+
+        delete transport;
+        transport = nullptr;
+    }
+    if (recorder != nullptr)
+    {
+        delete recorder;
+        recorder = nullptr;
     }
     logger.info("Spectrometer::close: end");
     return true;
@@ -179,9 +207,41 @@ bool WasatchVCPP::Spectrometer::readEEPROM()
     {
         srm_in_EEPROM = true;
     }
+    cacheRamanIntensityFactors();
     return true;
 }
 
+//! Evaluate the SRM Raman intensity calibration once for every pixel, so 
+//! neither wp_get_raman_intensity_factors nor in-driver correction need 
+//! re-expand the polynomial per spectrum.
+void WasatchVCPP::Spectrometer::cacheRamanIntensityFactors()
+{
+    ramanIntensityFactors.clear();
+    if (eeprom.intensityCorrectionCoeffs.empty())
+        return;
+
+    ramanIntensityFactors.resize(eeprom.activePixelsHoriz);
+    for (int px = 0; px < eeprom.activePixelsHoriz; px++)
+        ramanIntensityFactors[px] = getRamanIntensityFactor(px);
+}
+
+//! @returns the SRM Raman intensity factor for the given (physical) pixel
+double WasatchVCPP::Spectrometer::getRamanIntensityFactor(int pixel)
+{
+    const auto& coeffs = eeprom.intensityCorrectionCoeffs;
+    if (coeffs.empty())
+        return 1.0;
+
+    if (pixel >= 0 && pixel < (int)ramanIntensityFactors.size())
+        return ramanIntensityFactors[pixel];
+
+    // Horner's method, rather than pow(px, j) per coefficient
+    double logTen = 0.0;
+    for (int j = (int)coeffs.size() - 1; j >= 0; j--)
+        logTen = logTen * pixel + coeffs[j];
+    return pow(10, logTen);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Opcodes
 ////////////////////////////////////////////////////////////////////////////////
@@ -209,6 +269,7 @@ bool WasatchVCPP::Spectrometer::setLaserPowerPerc(float percent)
     }
 
     float value = float(max(0.f, min(100.f, percent)));
+    laserPowerPerc = value;
     logger.debug("set_laser_power_perc: range (0, 100), requested %.2f, applying %.2f", percent, value);
 
     // If zero, disable laser
@@ -367,6 +428,7 @@ bool WasatchVCPP::Spectrometer::setDetectorGain(float value)
     uint16_t word = serializeGain(value);
 
     auto bytesWritten = sendCmd(op, word);
+    detectorGain = value;
     logger.debug("detectorGain -> 0x%04x (%.2f)", word, value);
     return bytesWritten >= 0;
 }
@@ -389,6 +451,7 @@ bool WasatchVCPP::Spectrometer::setDetectorOffset(int16_t value)
     const uint8_t op = 0xb6;
     uint16_t word = *((uint16_t*) &value); // send original signed int16 bit pattern
     auto bytesWritten = sendCmd(op, word);
+    detectorOffset = value;
     logger.debug("detectorOffset -> 0x%04x (%d)", word, value);
     return bytesWritten >= 0;
 }
@@ -467,6 +530,32 @@ bool WasatchVCPP::Spectrometer::setHighGainModeEnable(bool flag)
     return bytesWritten >= 0;
 }
 
+//! Select whether acquisitions are started by ACQUIRE (internal) or by the
+//! external trigger input.
+//!
+//! ARM firmware doesn't implement SET_TRIGGER_SOURCE (Wasatch.PY doesn't 
+//! send it either), and offers no other way to select the trigger input, so
+//! ARM units can only be triggered internally: selecting the external 
+//! trigger fails, and selecting the internal trigger is a no-op.
+bool WasatchVCPP::Spectrometer::setTriggerSource(bool external)
+{
+    const uint8_t op = 0xd2;
+    if (isARM())
+    {
+        if (external)
+        {
+            logger.error("setTriggerSource: external trigger not supported on ARM");
+            return false;
+        }
+        logger.debug("setTriggerSource: not sent to ARM");
+        return true;
+    }
+
+    auto bytesWritten = sendCmd(op, external ? 1 : 0);
+    logger.debug("triggerSource -> %s", external ? "external" : "internal");
+    return bytesWritten >= 0;
+}
+
 string WasatchVCPP::Spectrometer::getFirmwareVersion()
 {
     string s = "ERROR";
@@ -524,6 +613,7 @@ float WasatchVCPP::Spectrometer::getDetectorTemperatureDegC()
                + eeprom.adcToDegCCoeffs[2] * raw * raw;
 
     logger.debug("detectorTemperatureDegC <- %.2f (0x%04x raw)", degC, raw);
+    lastDetectorTemperatureDegC = degC;
     return degC;
 }
 
@@ -542,7 +632,10 @@ bool WasatchVCPP::Spectrometer::cancelOperation(bool blocking)
     // This will cause this class's bulk endpoint read "retry loop" to stop 
     // cycling, at least within maxTimeoutMS.  However, this doesn't actually 
     // change anything inside the hardware spectrometer.
-    operationCancelled = true;
+    //
+    // Asynchronous (and simulated) reads can be aborted immediately, rather 
+    // than waiting for the current timeout to expire.
+    abortRead();
 
     // To actually cause the spectrometer to abruptly end the current acquisition
     // before the original scheduled "end-of-integration time," we need to reduce
@@ -573,6 +666,19 @@ bool WasatchVCPP::Spectrometer::cancelOperation(bool blocking)
     return true;
 }
 
+//! Abort any bulk read in progress (unlike cancelOperation, leaving the 
+//! integration time alone).
+void WasatchVCPP::Spectrometer::abortRead()
+{
+    operationCancelled = true;
+
+    std::lock_guard<std::mutex> lock(mutAsyncReader);
+    for (auto reader : asyncReaders)
+        reader->cancel();
+    if (transport != nullptr)
+        transport->cancel();
+}
+
 //! Determine how long we should wait for an acquisition to return the spectrum.
 //!
 //! Note that this is the "full period" we should wait, which may end up being
@@ -586,95 +692,1057 @@ long WasatchVCPP::Spectrometer::generateTotalWaitMS()
          + 500;
 }
 
+//! Configure how many bulk transfers are kept "in flight" when reading
+//! spectra (0 reverts to the original blocking reads).
+//!
+//! @param count (Input) number of concurrent transfers per endpoint read
+//! @returns true on success (false, with blocking reads, if the transport
+//!          doesn't support asynchronous ones)
+bool WasatchVCPP::Spectrometer::setAsyncBulkTransfers(int count)
+{
+    if (count < 0 || count > AsyncBulkReader::MAX_TRANSFERS)
+    {
+        logger.error("setAsyncBulkTransfers: invalid count %d", count);
+        return false;
+    }
+
+    // a triggered acquisition can hold mutAcquisition for hours
+    if (isTriggered())
+    {
+        logger.error("setAsyncBulkTransfers: not permitted while triggered");
+        return false;
+    }
+
+    // don't swap readers in the middle of an acquisition
+    std::lock_guard<std::mutex> acqLock(mutAcquisition);
+    std::lock_guard<std::mutex> lock(mutAsyncReader);
+
+    for (auto reader : asyncReaders)
+        delete reader;
+    asyncReaders.clear();
+
+    // one reader per endpoint, as endpoints are read concurrently (unless 
+    // the transport only supports blocking reads)
+    if (count > 0 && transport != nullptr)
+    {
+        for (size_t i = 0; i < endpoints.size(); i++)
+        {
+            AsyncBulkReader* reader = transport->createAsyncReader(count, logger);
+            if (reader == nullptr)
+            {
+                logger.error("setAsyncBulkTransfers: not supported by transport");
+                return false;
+            }
+            asyncReaders.push_back(reader);
+        }
+    }
+
+    logger.debug("asyncBulkTransfers -> %d", count);
+    return true;
+}
+
+int WasatchVCPP::Spectrometer::getAsyncBulkTransfers()
+{
+    std::lock_guard<std::mutex> lock(mutAsyncReader);
+    return asyncReaders.empty() ? 0 : asyncReaders[0]->getTransferCount();
+}
+
+//! @returns a snapshot of this spectrometer's USB counters (each read
+//!          atomically, though not all at the same instant)
+WasatchVCPP::UsbStats WasatchVCPP::Spectrometer::getUsbStats()
+{
+    UsbStats stats;
+    stats.bulkBytesRead    = usbBulkBytesRead;
+    stats.bulkTransfers    = usbBulkTransfers;
+    stats.bulkTimeouts     = usbBulkTimeouts;
+    stats.bulkRetries      = usbBulkRetries;
+    stats.bulkOddReads     = usbBulkOddReads;
+    stats.bulkFailures     = usbBulkFailures;
+    stats.cancellations    = usbCancellations;
+    stats.controlTransfers = usbControlTransfers;
+    stats.controlFailures  = usbControlFailures;
+    return stats;
+}
+
+//! Convenience wrapper over getSpectrum(double*, int).
+//!
+//! @returns spectrum of getSpectrumLength() intensities, or an empty vector on error
 std::vector<double> WasatchVCPP::Spectrometer::getSpectrum()
 {
-    mutAcquisition.lock();
-    logger.debug("getSpectrum started on %", eeprom.serialNumber.c_str());
+    vector<double> spectrum(getSpectrumLength());
+    if (!getSpectrum(spectrum.data(), (int)spectrum.size()))
+        spectrum.clear();
+    return spectrum;
+}
+
+//! Acquire one spectrum directly into a caller-owned buffer.
+//!
+//! Pixels are demarshalled straight from the USB buffer into 'spectrum' and
+//! post-processed in place, so no heap allocations occur (other than within
+//! DEBUG logging).
+//!
+//! If an output axis has been set, the spectrum is instead acquired and 
+//! post-processed in an internal buffer, then resampled into 'spectrum'.
+//!
+//! @param spectrum (Output) receives getSpectrumLength() intensities
+//! @param len (Input) allocated length of 'spectrum'
+//! @param sendTrigger (Input) false if ACQUIRE was already sent (e.g. through
+//!        sendSoftwareTrigger), and the spectrum only needs to be read
+//! @returns true on success
+bool WasatchVCPP::Spectrometer::getSpectrum(double* spectrum, int len, bool sendTrigger)
+{
+    return getProcessedSpectrum(spectrum, len, sendTrigger);
+}
+
+//! @see getSpectrum(double*, int, bool)
+bool WasatchVCPP::Spectrometer::getSpectrum(float* spectrum, int len, bool sendTrigger)
+{
+    return getProcessedSpectrum(spectrum, len, sendTrigger);
+}
+
+//! Trigger and read one spectrum, as getSpectrum(double*, int, bool), also
+//! reporting the circumstances of its acquisition.
+//!
+//! @param metadata (Output) filled on success
+bool WasatchVCPP::Spectrometer::getSpectrum(double* spectrum, int len, Metadata& metadata)
+{
+    return getProcessedSpectrum(spectrum, len, true, &metadata);
+}
+
+template<typename T>
+bool WasatchVCPP::Spectrometer::getProcessedSpectrum(T* spectrum, int len, bool sendTrigger, Metadata* metadata)
+{
+    int count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutOutputAxis);
+        count = pipeline.getOutputLength();
+    }
+
+    if (count == 0)
+    {
+        if (!acquireSpectrum(spectrum, len, sendTrigger, pipeline.getInvertX(), pipeline.getLinearityLUT(), metadata))
+            return false;
+        pipeline.process(spectrum);
+        return true;
+    }
 
-    // perform clean-up from cancelled operation, if any
+    if (spectrum == nullptr || len < count)
+    {
+        logger.error("getSpectrum: insufficient storage (%d < %d points)", len, count);
+        return false;
+    }
+
+    // acquire outside mutOutputAxis, so that a slow (or externally 
+    // triggered) read doesn't stall other threads' use of the axis
+    if ((int)resampleInput.size() < pixels)
+        resampleInput.resize(pixels);
+    double* native = resampleInput.data();
+    if (!acquireSpectrum(native, pixels, sendTrigger, pipeline.getInvertX(), pipeline.getLinearityLUT(), metadata))
+        return false;
+    pipeline.process(native);
+
+    std::lock_guard<std::mutex> lock(mutOutputAxis);
+    if (pipeline.getOutputLength() != count)
+    {
+        logger.error("getSpectrum: output axis changed during acquisition");
+        return false;
+    }
+    pipeline.resample(native, spectrum);
+    return true;
+}
+
+//! @returns length of spectra returned by getSpectrum (the output axis, if
+//!          set, else pixels)
+int WasatchVCPP::Spectrometer::getSpectrumLength()
+{
+    int count = pipeline.getOutputLength();
+    return count > 0 ? count : pixels;
+}
+
+//! Resample every spectrum returned by getSpectrum onto an evenly-spaced 
+//! axis, so that all units report directly comparable arrays.
+//!
+//! @param start (Input) first point of the output axis
+//! @param step (Input) spacing of the output axis (positive)
+//! @param count (Input) points in the output axis (0 to restore native pixels)
+//! @param wavenumber (Input) true for Raman shift (cm-1), false for wavelength (nm)
+//! @returns ErrorCodes::Success, Busy (during continuous acquisition), 
+//!          NoLaser (no wavenumber axis) or Error
+int WasatchVCPP::Spectrometer::setOutputAxis(double start, double step, int count, bool wavenumber)
+{
+    std::lock_guard<std::mutex> lock(mutOutputAxis);
+    if (continuousRunning)
+    {
+        logger.error("setOutputAxis: continuous acquisition is running");
+        return ErrorCodes::Busy;
+    }
+
+    if (count == 0)
+    {
+        pipeline.clearOutputAxis();
+        return ErrorCodes::Success;
+    }
+
+    if (wavenumber && wavenumbers.empty())
+    {
+        logger.error("setOutputAxis: no wavenumber axis (excitation unknown)");
+        return ErrorCodes::NoLaser;
+    }
+
+    if (!pipeline.setOutputAxis(start, step, count, wavenumber ? wavenumbers : wavelengths))
+    {
+        logger.error("setOutputAxis: invalid axis (start %lf, step %lf, count %d)", start, step, count);
+        return ErrorCodes::Error;
+    }
+
+    outputAxisStart = start;
+    outputAxisStep = step;
+    outputAxisWavenumber = wavenumber;
+    logger.debug("setOutputAxis: %d points from %lf by %lf %s", count, start, step, wavenumber ? "cm-1" : "nm");
+    return ErrorCodes::Success;
+}
+
+//! Acquire one spectrum of raw ADC counts, without widening to floating-point.
+//!
+//! When requested, invert-X and bad-pixel correction are applied in integer
+//! arithmetic (interpolated pixels are rounded to the nearest count).  2x2
+//! binning is never applied to raw spectra.
+//!
+//! @param spectrum (Output) receives 'pixels' demarshalled 16-bit words
+//! @param len (Input) allocated length of 'spectrum'
+//! @param postProcess (Input) whether to apply invert-X and bad-pixel correction
+//! @returns true on success
+bool WasatchVCPP::Spectrometer::getSpectrumRaw(uint16_t* spectrum, int len, bool postProcess)
+{
+    if (!acquireSpectrum(spectrum, len, true, postProcess && pipeline.getInvertX()))
+        return false;
+
+    if (postProcess)
+        pipeline.process(spectrum);
+    return true;
+}
+
+//! Send a software trigger (ACQUIRE) without reading the resulting spectrum,
+//! which should subsequently be read via getSpectrum(..., sendTrigger=false).
+//!
+//! Splitting trigger from read allows several spectrometers to be triggered
+//! back-to-back before any of them are read (see Driver::acquireAll).
+//!
+//! @returns true on success
+bool WasatchVCPP::Spectrometer::sendSoftwareTrigger()
+{
+    std::lock_guard<std::mutex> lock(mutAcquisition);
+    if (acquiring)
+    {
+        logger.error("sendSoftwareTrigger: Spectrometer %s already acquiring", eeprom.serialNumber.c_str());
+        return false;
+    }
+    return triggerAcquisition();
+}
+
+//! @returns when the last ACQUIRE was sent (Util::timestampUS)
+long long WasatchVCPP::Spectrometer::getLastTriggerTimestampUS() { return lastTriggerTimestampUS; }
+
+//! @returns when the last spectrum finished arriving over USB (Util::timestampUS)
+long long WasatchVCPP::Spectrometer::getLastReceiveTimestampUS() { return lastReceiveTimestampUS; }
+
+//! caller is expected to hold mutAcquisition
+//!
+//! @returns true if ACQUIRE was sent (only then is lastTriggerTimestampUS 
+//!          updated)
+bool WasatchVCPP::Spectrometer::triggerAcquisition()
+{
+    // perform clean-up from cancelled operation, if any (this must precede the
+    // trigger, or the restored integration time won't apply until next time)
     if (lastAcquisitionWasCancelled)
     {
         setIntegrationTimeMS(cancelledIntegrationTimeMS);
         lastAcquisitionWasCancelled = false;
     }
 
-    vector<double> spectrum;
+    logger.debug("sending ACQUIRE");
+    if (sendCmd(0xad) < 0)
+    {
+        logger.error("failed to send ACQUIRE");
+        return false;
+    }
+    lastTriggerTimestampUS = Util::timestampUS();
+    return true;
+}
+
+//! Triggers (if requested) and reads one spectrum, demarshalling each 
+//! endpoint's pixels straight into the output buffer (no post-processing,
+//! other than the pipeline stages folded into demarshalling: invert-X and 
+//! nonlinearity correction).
+//!
+//! @param metadata (Output) if non-null, filled on success
+template<typename T>
+bool WasatchVCPP::Spectrometer::acquireSpectrum(T* spectrum, int len, bool sendTrigger, bool invert, const float* linearityLUT, Metadata* metadata)
+{
+    if (spectrum == nullptr || len < pixels)
+    {
+        logger.error("getSpectrum: insufficient storage (%d < %d pixels)", len, pixels);
+        return false;
+    }
+
+    mutAcquisition.lock();
+    logger.debug("getSpectrum started on %s", eeprom.serialNumber.c_str());
+
     if (acquiring)
     {
         // just in case
         logger.error("Spectrometer %s already acquiring", eeprom.serialNumber.c_str());
         mutAcquisition.unlock();
-        return spectrum;
+        return false;
     }
 
     operationCancelled = false;
     acquiring = true;
+    uint64_t sequence = acquisitionCount++;
 
-    // send software trigger
-    logger.debug("sending ACQUIRE");
-    sendCmd(0xad);
+    // send software trigger (there's no point waiting for a spectrum which
+    // was never requested)
+    if (sendTrigger && !triggerAcquisition())
+    {
+        acquiring = false;
+        mutAcquisition.unlock();
+        return false;
+    }
+    long long triggerTimestampUS = externalTrigger ? 0 : lastTriggerTimestampUS.load();
 
-    // how long we'll wait for the FIRST subspectrum
-    int subspectrumTimeoutMS = generateTotalWaitMS();
+    bool ok = readSubspectra();
 
-    for (auto ep : endpoints)
+    // Scan averaging: accumulate the raw words of each scan, re-triggering
+    // the next scan before accumulating the current one so the summation 
+    // overlaps the next integration.
+    int scans = scansToAverage;
+    if (ok && scans > 1)
     {
-        auto subspectrum = getSubspectrum(ep, subspectrumTimeoutMS);
-        if (subspectrum.size() != pixelsPerEndpoint)
+        std::fill(accumulator.begin(), accumulator.end(), 0);
+        for (int scan = 1; scan <= scans; scan++)
         {
-            if (operationCancelled)
-                logger.debug("getSpectrum: operation cancelled");
-            else
-                logger.error("failed reading subspectrum (%d of %d pixels read)", 
-                    subspectrum.size(), pixelsPerEndpoint);
-            operationCancelled = false;
-            acquiring = false;
-            mutAcquisition.unlock();
-            return vector<double>();
-        }
+            // externally-triggered scans each await their own trigger
+            if (scan < scans && !externalTrigger && !triggerAcquisition())
+            {
+                ok = false;
+                break;
+            }
 
-        for (auto word : subspectrum)
-            spectrum.push_back(word);
+            accumulate();
 
-        // subspectra from subsequent endpoints should be nearly instantaneous 
-        // (USB comms only)
-        subspectrumTimeoutMS = 100 * driver->getNumberOfSpectrometers();
+            if (scan < scans && !readSubspectra())
+            {
+                ok = false;
+                break;
+            }
+        }
     }
 
-    ////////////////////////////////////////////////////////////////////////////
-    // post-processing
-    ////////////////////////////////////////////////////////////////////////////
-
-    // stomp first pixel -- only required if start-of-frame marker enabled
-    // spectrum[0] = spectrum[1];
+    if (!ok)
+    {
+        if (operationCancelled)
+            logger.debug("getSpectrum: operation cancelled");
+        else
+        {
+            logger.error("failed reading subspectra");
+            droppedSpectra++;
+        }
+        operationCancelled = false;
+        acquiring = false;
+        mutAcquisition.unlock();
+        return false;
+    }
 
-    if (eeprom.featureMask.invertXAxis)
-        std::reverse(spectrum.begin(), spectrum.end());
+    lastReceiveTimestampUS = Util::timestampUS();
 
-    correctBadPixels(spectrum);
+    if (metadata != nullptr)
+    {
+        metadata->triggerTimestampUS = triggerTimestampUS;
+        metadata->receiveTimestampUS = lastReceiveTimestampUS;
+        metadata->sequence = sequence;
+        metadata->drops = droppedSpectra;
+        metadata->integrationTimeMS = integrationTimeMS;
+        metadata->scansAveraged = scans;
+        metadata->detectorGain = detectorGain;
+        metadata->detectorOffset = detectorOffset;
+        metadata->laserEnabled = laserEnabled;
+        metadata->laserPowerPerc = laserPowerPerc;
+        metadata->detectorTemperatureDegC = lastDetectorTemperatureDegC;
+    }
 
-    if (eeprom.featureMask.bin2x2)
-        spectrum = bin2x2(spectrum);
+    if (scans > 1)
+        average(spectrum, scans, invert, linearityLUT);
+    else
+        demarshal(spectrum, invert, linearityLUT);
 
-    logger.debug("getSpectrum: returning spectrum of %d pixels", spectrum.size());
+    logger.debug("getSpectrum: returning spectrum of %d pixels", pixels);
     acquiring = false;
     mutAcquisition.unlock();
-    return spectrum;
+    return true;
+}
+
+//! Read the spectrum of one (already-triggered) acquisition into bufSubspectra.
+//!
+//! Any additional endpoints are read on endpointThread while we read the 
+//! first one here.
+//!
+//! While waiting on an external trigger, there is no telling when the 
+//! spectrum will come, so we wait indefinitely.
+//!
+//! @returns true if all endpoints were read
+bool WasatchVCPP::Spectrometer::readSubspectra()
+{
+    // how long we'll wait for the FIRST subspectrum (0 for ever)
+    long subspectrumTimeoutMS = externalTrigger ? 0 : generateTotalWaitMS();
+
+    // subspectra from subsequent endpoints follow "nearly instantaneously" 
+    // (USB comms only) after the first, so allow them that much longer
+    if (endpoints.size() > 1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutEndpoint);
+            endpointTimeoutMS = externalTrigger ? 0 : subspectrumTimeoutMS + 100 * driver->getNumberOfSpectrometers();
+            endpointPending = true;
+        }
+        cvEndpoint.notify_all();
+    }
+
+    bool ok = getSubspectrum(0, subspectrumTimeoutMS);
+
+    if (endpoints.size() > 1)
+    {
+        std::unique_lock<std::mutex> lock(mutEndpoint);
+        cvEndpoint.wait(lock, [this] { return !endpointPending; });
+        ok = ok && endpointSuccess;
+    }
+    return ok;
 }
 
-//! @param allocatedMS (Input) total time allocated in milliseconds (wall-clock)
-//! @returns either a populated subspectrum of exactly 'pixelsPerEndpoint' 
-//!          deserialized pixels, or an empty vector on error
-std::vector<uint16_t> WasatchVCPP::Spectrometer::getSubspectrum(uint8_t ep, long allocatedMS)
+//! the i'th little-endian pixel of a subspectrum
+static inline uint16_t toPixel(const uint8_t* bytes, int i)
+{
+    return (uint16_t)(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+}
+
+//! linearly interpolate the nonlinearity table at fractional (averaged) counts
+static inline double lookupLinearity(const float* linearityLUT, double counts)
+{
+    int index = min(max((int)counts, 0), 65534);
+    double frac = counts - index;
+    return linearityLUT[index] + frac * (linearityLUT[index + 1] - linearityLUT[index]);
+}
+
+//! demarshal little-endian pixels, each endpoint filling the next 
+//! 'pixelsPerEndpoint' of the output (or the previous, if inverting)
+//!
+//! @param linearityLUT (Input) if non-null, each pixel is replaced by its 
+//!        nonlinearity-corrected value (ProcessingPipeline::getLinearityLUT)
+template<typename T>
+void WasatchVCPP::Spectrometer::demarshal(T* spectrum, bool invert, const float* linearityLUT)
+{
+    int offset = 0;
+    for (auto& buf : bufSubspectra)
+    {
+        const uint8_t* bytes = buf.data();
+        T* dest = invert ? spectrum + pixels - 1 - offset : spectrum + offset;
+        if (linearityLUT != nullptr)
+        {
+            const int step = invert ? -1 : 1;
+            for (int i = 0; i < pixelsPerEndpoint; i++)
+                dest[i * step] = (T)linearityLUT[toPixel(bytes, i)];
+        }
+        else if (invert)
+        {
+            for (int i = 0; i < pixelsPerEndpoint; i++)
+                dest[-i] = toPixel(bytes, i);
+        }
+        else
+        {
+            for (int i = 0; i < pixelsPerEndpoint; i++)
+                dest[i] = toPixel(bytes, i);
+        }
+        offset += pixelsPerEndpoint;
+    }
+}
+
+//! Add the little-endian pixels in bufSubspectra to the scan-averaging 
+//! accumulator.
+//!
+//! The loop bodies are deliberately simple (no intrinsics), leaving 
+//! vectorization to the compiler for whichever target we're built on 
+//! (SSE/AVX on x86, NEON on ARM).
+void WasatchVCPP::Spectrometer::accumulate()
+{
+    uint32_t* acc = accumulator.data();
+    for (auto& buf : bufSubspectra)
+    {
+        const uint8_t* bytes = buf.data();
+        for (int i = 0; i < pixelsPerEndpoint; i++)
+            acc[i] += toPixel(bytes, i);
+        acc += pixelsPerEndpoint;
+    }
+}
+
+//! convert the scan-averaging accumulator into the averaged spectrum
+//!
+//! Nonlinearity correction is applied to the averaged counts (interpolating
+//! the table between integral counts), rather than to each scan.
+template<typename T>
+void WasatchVCPP::Spectrometer::average(T* spectrum, int scans, bool invert, const float* linearityLUT)
+{
+    const double scale = 1.0 / scans;
+    if (linearityLUT != nullptr)
+        for (int i = 0; i < pixels; i++)
+            spectrum[invert ? pixels - 1 - i : i] = (T)lookupLinearity(linearityLUT, accumulator[i] * scale);
+    else if (invert)
+        for (int i = 0; i < pixels; i++)
+            spectrum[pixels - 1 - i] = (T)(accumulator[i] * scale);
+    else
+        for (int i = 0; i < pixels; i++)
+            spectrum[i] = (T)(accumulator[i] * scale);
+}
+
+//! integer version for raw spectra (rounds to nearest count, and applies 
+//! any nonlinearity correction just as the floating-point version does)
+void WasatchVCPP::Spectrometer::average(uint16_t* spectrum, int scans, bool invert, const float* linearityLUT)
+{
+    if (linearityLUT != nullptr)
+    {
+        const double scale = 1.0 / scans;
+        for (int i = 0; i < pixels; i++)
+        {
+            double corrected = lookupLinearity(linearityLUT, accumulator[i] * scale);
+            spectrum[invert ? pixels - 1 - i : i] = (uint16_t)min(max(corrected + 0.5, 0.0), 65535.0);
+        }
+    }
+    else if (invert)
+        for (int i = 0; i < pixels; i++)
+            spectrum[pixels - 1 - i] = (uint16_t)((accumulator[i] + scans / 2) / scans);
+    else
+        for (int i = 0; i < pixels; i++)
+            spectrum[i] = (uint16_t)((accumulator[i] + scans / 2) / scans);
+}
+
+//! Average this many scans within each spectrum returned by getSpectrum (and
+//! its variants).  Only the final averaged spectrum is post-processed.
+//!
+//! @param n (Input) scans per spectrum (1 to disable averaging)
+//! @returns true on success (false while awaiting external triggers)
+bool WasatchVCPP::Spectrometer::setScansToAverage(int n)
+{
+    // the accumulator must not overflow (65535 * 65535 < 2^32)
+    if (n < 1 || n > 65535)
+    {
+        logger.error("setScansToAverage: invalid value %d", n);
+        return false;
+    }
+
+    // a triggered acquisition can hold mutAcquisition for hours
+    if (isTriggered())
+    {
+        logger.error("setScansToAverage: not permitted while triggered");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutAcquisition);
+    accumulator.resize(n > 1 ? pixels : 0);
+    scansToAverage = n;
+    logger.debug("scansToAverage -> %d", n);
+    return true;
+}
+
+int WasatchVCPP::Spectrometer::getScansToAverage() { return scansToAverage; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Peakfinding
+////////////////////////////////////////////////////////////////////////////////
+
+//! @returns the given axis linearly interpolated at a fractional pixel
+static double interpolateAxis(const vector<double>& axis, double pixel)
+{
+    int n = (int)axis.size();
+    int i = min(max((int)pixel, 0), n - 2);
+    return axis[i] + (pixel - i) * (axis[i + 1] - axis[i]);
+}
+
+//! Find peaks in a spectrum returned by getSpectrum, reporting the position 
+//! of each in pixels, nm and cm-1.
+//!
+//! @param spectrum (Input) either native pixels, or points on the current 
+//!        output axis (in which case 'pixel' is the index on that axis)
+//! @param len (Input) length of spectrum
+//! @param params (Input) constraints on reported peaks
+//! @param maxPeaks (Input) report at most this many (the most prominent)
+//! @param peaks (Output) reported peaks, in order of position
+//! @returns number of peaks, or ErrorCodes::Error if 'len' matches neither
+//!          the native pixels nor the output axis
+int WasatchVCPP::Spectrometer::findPeaks(const double* spectrum, int len, const PeakFinder::Params& params, int maxPeaks, vector<PeakFinder::Peak>& peaks)
+{
+    PeakAxis axis;
+    if (!getPeakAxis(len, axis))
+        return ErrorCodes::Error;
+
+    peakFinder.find(spectrum, len, params, maxPeaks, peaks);
+    for (auto& peak : peaks)
+        locatePeak(axis, peak.pixel, peak.wavelength, peak.wavenumber);
+    return (int)peaks.size();
+}
+
+//! Acquire a spectrum (exactly as getSpectrum) and report only its peaks.
+//!
+//! @see findPeaks
+int WasatchVCPP::Spectrometer::getSpectrumPeaks(const PeakFinder::Params& params, int maxPeaks, vector<PeakFinder::Peak>& peaks)
+{
+    std::lock_guard<std::mutex> lock(mutPeaks);
+    peakSpectrum.resize(getSpectrumLength());
+    if (!getSpectrum(peakSpectrum.data(), (int)peakSpectrum.size()))
+        return ErrorCodes::Error;
+    return findPeaks(peakSpectrum.data(), (int)peakSpectrum.size(), params, maxPeaks, peaks);
+}
+
+//! Fit a line shape to each guessed peak in a spectrum returned by 
+//! getSpectrum, reporting each fitted center in pixels, nm and cm-1.
+//!
+//! @param spectrum (Input) either native pixels, or points on the current 
+//!        output axis
+//! @param len (Input) length of spectrum
+//! @param shape (Input) line shape to fit
+//! @param guesses (Input) initial estimate of each peak (e.g. from findPeaks)
+//! @param fits (Output) one fit per guess, in the same order
+//! @returns number of fits which converged, or ErrorCodes::Error if 'len' 
+//!          matches neither the native pixels nor the output axis
+int WasatchVCPP::Spectrometer::fitPeaks(const double* spectrum, int len, PeakFitter::Shape shape, const vector<PeakFitter::Guess>& guesses, vector<PeakFitter::Fit>& fits)
+{
+    PeakAxis axis;
+    if (!getPeakAxis(len, axis))
+        return ErrorCodes::Error;
+
+    int converged = peakFitter.fit(spectrum, len, shape, guesses, fits);
+    for (auto& fit : fits)
+        locatePeak(axis, fit.pixel, fit.wavelength, fit.wavenumber);
+    return converged;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dark and Reference
+////////////////////////////////////////////////////////////////////////////////
+
+//! Acquire a spectrum (averaged, inverted and linearity-corrected as any 
+//! other) and store it as the dark, subtracted from all subsequent spectra.
+//!
+//! The caller is responsible for blocking the light (or disabling the laser).
+bool WasatchVCPP::Spectrometer::storeDark()
+{
+    vector<double> spectrum(pixels);
+    if (!acquireSpectrum(spectrum.data(), pixels, true, pipeline.getInvertX(), pipeline.getLinearityLUT()))
+        return false;
+    return pipeline.setDark(spectrum);
+}
+
+//! Acquire a spectrum and store it as the reference, against which 
+//! subsequent spectra are ratioed in transmission, reflectance and 
+//! absorbance modes.
+//!
+//! The reference is dark-corrected when used, so a dark may be stored 
+//! before or after it.
+bool WasatchVCPP::Spectrometer::storeReference()
+{
+    vector<double> spectrum(pixels);
+    if (!acquireSpectrum(spectrum.data(), pixels, true, pipeline.getInvertX(), pipeline.getLinearityLUT()))
+        return false;
+    return pipeline.setReference(spectrum);
+}
+
+//! @returns false (logging why) if 'len' matches neither the native pixels
+//!          nor the output axis
+bool WasatchVCPP::Spectrometer::getPeakAxis(int len, PeakAxis& axis)
+{
+    int axisLen = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutOutputAxis);
+        axisLen = pipeline.getOutputLength();
+        axis.start = outputAxisStart;
+        axis.step = outputAxisStep;
+        axis.wavenumber = outputAxisWavenumber;
+    }
+
+    axis.resampled = axisLen > 0 && len == axisLen;
+    if (!axis.resampled && (len != pixels || pixels < 2))
+    {
+        logger.error("spectrum length %d matches neither pixels nor output axis", len);
+        return false;
+    }
+    return true;
+}
+
+//! convert a (fractional) position within a spectrum to nm and cm-1 
+//! (cm-1 is 0 if there is no excitation)
+void WasatchVCPP::Spectrometer::locatePeak(const PeakAxis& axis, double pixel, double& wavelength, double& wavenumber)
+{
+    const double laserCm = eeprom.excitationNM > 0 ? 1e7 / eeprom.excitationNM : 0;
+    if (!axis.resampled)
+    {
+        wavelength = interpolateAxis(wavelengths, pixel);
+        wavenumber = wavenumbers.empty() ? 0 : interpolateAxis(wavenumbers, pixel);
+    }
+    else if (axis.wavenumber)
+    {
+        wavenumber = axis.start + pixel * axis.step;
+        wavelength = 1e7 / (laserCm - wavenumber);
+    }
+    else
+    {
+        wavelength = axis.start + pixel * axis.step;
+        wavenumber = laserCm > 0 && wavelength > 0 ? laserCm - 1e7 / wavelength : 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Continuous Acquisition
+////////////////////////////////////////////////////////////////////////////////
+
+//! Start a background thread which acquires spectra back-to-back into a ring
+//! of 'depth' preallocated frames, to be consumed through readNextSpectrum.
+//!
+//! If triggered, the spectrometer is instead switched to its external 
+//! trigger input, and the thread keeps a bulk read pending (with no 
+//! timeout) for each triggered spectrum.  The thread sleeps in the kernel
+//! until the spectrum arrives, however long that takes.  Blocking libusb 
+//! reads can't be cancelled, so unless the transport's can (see 
+//! Transport::isCancellable), this enables asynchronous reads (one 
+//! transfer per endpoint) if they aren't already.  Triggering isn't 
+//! supported on ARM units (see setTriggerSource).
+//!
+//! @param depth (Input) number of spectra the ring can hold
+//! @param triggered (Input) wait on the external trigger, rather than 
+//!        sending ACQUIRE
+//! @returns true on success
+bool WasatchVCPP::Spectrometer::startContinuous(int depth, bool triggered)
+{
+    std::lock_guard<std::mutex> lock(mutContinuous);
+    return launchContinuous(depth, triggered);
+}
+
+//! @see startContinuous
+//! @note caller must hold mutContinuous
+bool WasatchVCPP::Spectrometer::launchContinuous(int depth, bool triggered)
+{
+    if (continuousRunning)
+    {
+        logger.error("startContinuous: already running");
+        return false;
+    }
+
+    // reap threads which stopped themselves after errors
+    if (continuousThread.joinable())
+        continuousThread.join();
+    if (callbackThread.joinable())
+        callbackThread.join();
+
+    // the output axis (and so frame length) can't change once we're running
+    std::lock_guard<std::mutex> axisLock(mutOutputAxis);
+    {
+        std::lock_guard<std::mutex> consumerLock(mutRingConsumer);
+        if (!ring.init(depth, getSpectrumLength()))
+        {
+            logger.error("startContinuous: invalid depth %d", depth);
+            return false;
+        }
+    }
+
+    if (triggered)
+    {
+        // otherwise we'd wait forever for spectra which never come
+        if (isARM())
+        {
+            logger.error("startContinuous: external triggering not supported on ARM");
+            return false;
+        }
+        bool cancellable = transport != nullptr && transport->isCancellable();
+        if (getAsyncBulkTransfers() == 0 && !cancellable && !setAsyncBulkTransfers(1))
+            return false;
+        if (!setTriggerSource(true))
+        {
+            logger.error("startContinuous: unable to select external trigger");
+            return false;
+        }
+    }
+
+    logger.debug("startContinuous: depth %d%s", depth, triggered ? " (triggered)" : "");
+    externalTrigger = triggered;
+    continuousExited = false;
+    continuousRunning = true;
+    continuousThread = std::thread(&Spectrometer::continuousLoop, this);
+    return true;
+}
+
+//! Stop continuous acquisition, blocking until the background thread exits.
+//! Any spectra still in the ring remain available to readNextSpectrum (or 
+//! are delivered to the spectrum callback, if registered).
+bool WasatchVCPP::Spectrometer::stopContinuous()
+{
+    // we'd never return from joining the thread we're running on
+    if (inSpectrumCallback)
+    {
+        logger.error("stopContinuous: not permitted from a spectrum callback");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutContinuous);
+    if (!continuousThread.joinable())
+        return false;
+
+    logger.debug("stopContinuous: stopping");
+    continuousRunning = false;
+
+    // The thread may be just about to submit the (possibly indefinite) read 
+    // we need to cancel, so keep cancelling until it notices it's stopped.
+    // Only the read is aborted (not cancelOperation, which would leave the
+    // unit at minimum integration time); a blocking read lets the in-flight
+    // scan finish.
+    while (!continuousExited)
+    {
+        abortRead();
+        Util::sleepMS(10);
+    }
+    continuousThread.join();
+    if (callbackThread.joinable())
+        callbackThread.join();
+
+    logger.debug("stopContinuous: stopped (%llu overruns)", (unsigned long long)ring.getOverruns());
+    return true;
+}
+
+bool WasatchVCPP::Spectrometer::isContinuous() { return continuousRunning; }
+
+//! @returns true while continuous acquisition waits on the external trigger
+bool WasatchVCPP::Spectrometer::isTriggered() { return continuousRunning && externalTrigger; }
+
+uint64_t WasatchVCPP::Spectrometer::getContinuousOverruns() { return ring.getOverruns(); }
+
+//! Pop the oldest spectrum from the continuous acquisition ring.
+//!
+//! @param spectrum (Output) caller-allocated buffer
+//! @param len (Input) capacity of 'spectrum'
+//! @param timeoutMS (Input) how long to wait for a spectrum (0 to poll,
+//!        negative to wait indefinitely)
+//! @param timestampUS (Output) if non-null, receives when the host received
+//!        the spectrum (Util::timestampUS)
+//! @returns ErrorCodes::Success, Timeout if nothing arrived in time, or Error
+//!          if continuous acquisition is not running (and the ring is empty)
+int WasatchVCPP::Spectrometer::readNextSpectrum(double* spectrum, int len, int timeoutMS, long long* timestampUS)
+{
+    // the callback thread is the ring's consumer
+    if (callbackActive)
+        return ErrorCodes::Error;
+
+    std::lock_guard<std::mutex> lock(mutRingConsumer);
+    if (callbackActive)
+        return ErrorCodes::Error;
+
+    if (!ring.waitForFrame(continuousRunning ? timeoutMS : 0))
+        return continuousRunning ? ErrorCodes::Timeout : ErrorCodes::Error;
+
+    auto frame = ring.peek();
+    int frameLen = (int)frame->spectrum.size();
+    if (len < frameLen)
+        return ErrorCodes::InsufficientStorage;
+
+    memcpy(spectrum, frame->spectrum.data(), frameLen * sizeof(double));
+    if (timestampUS != nullptr)
+        *timestampUS = frame->timestampUS;
+    ring.pop();
+    return ErrorCodes::Success;
+}
+
+//! body of continuousThread
+void WasatchVCPP::Spectrometer::continuousLoop()
+{
+    // give up if the device appears to have gone away
+    const int MAX_CONSECUTIVE_ERRORS = 5;
+
+    // where spectra go when the ring is full
+    vector<double> overflow(getSpectrumLength());
+
+    uint64_t sequence = 0;
+    int consecutiveErrors = 0;
+    while (continuousRunning)
+    {
+        // acquire straight into the next free slot
+        auto frame = ring.beginWrite();
+        double* spectrum = frame != nullptr ? frame->spectrum.data() : overflow.data();
+
+        bool ok = getSpectrum(spectrum, (int)overflow.size(), !externalTrigger);
+        if (!continuousRunning)
+            break;
+
+        if (!ok)
+        {
+            if (++consecutiveErrors >= MAX_CONSECUTIVE_ERRORS)
+            {
+                logger.error("continuousLoop: giving up after %d consecutive errors", consecutiveErrors);
+                continuousRunning = false;
+            }
+            continue;
+        }
+        consecutiveErrors = 0;
+
+        // if the consumer has fallen behind, the spectrum is dropped (and 
+        // counted) rather than stalling the detector
+        if (frame != nullptr)
+        {
+            frame->sequence = sequence;
+            frame->timestampUS = lastReceiveTimestampUS;
+            ring.endWrite();
+        }
+        else
+        {
+            ring.addOverrun();
+            droppedSpectra++;
+        }
+        sequence++;
+    }
+
+    if (externalTrigger)
+    {
+        setTriggerSource(false);
+        externalTrigger = false;
+    }
+
+    // release any reader still waiting on a frame that won't come
+    ring.wake();
+    continuousExited = true;
+}
+
+//! Deliver each continuously-acquired spectrum to a callback, on a thread of
+//! our own, instead of through readNextSpectrum.
+//!
+//! Continuous acquisition is started with a ring of 'depth' frames, unless 
+//! already running (e.g. triggered).  Each frame is passed to the callback 
+//! in place, and only released back to the ring when the callback returns; 
+//! meanwhile acquisition carries on into the ring's other frames.  If the 
+//! callback falls a whole ring behind, spectra are dropped (and counted as 
+//! overruns) rather than stalling acquisition.
+//!
+//! @param callback (Input) empty to stop acquisition (as stopContinuous)
+//! @param depth (Input) frames in the ring, if starting acquisition
+//! @returns true on success
+bool WasatchVCPP::Spectrometer::setSpectrumCallback(const SpectrumCallback& callback, int depth)
+{
+    if (!callback)
+        return stopContinuous();
+
+    if (inSpectrumCallback)
+    {
+        logger.error("setSpectrumCallback: not permitted from a spectrum callback");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutContinuous);
+    if (callbackActive)
+    {
+        logger.error("setSpectrumCallback: callback already registered");
+        return false;
+    }
+
+    if (!continuousRunning && !launchContinuous(depth, false))
+        return false;
+
+    // reap a callback thread which exited with an earlier acquisition
+    if (callbackThread.joinable())
+        callbackThread.join();
+
+    spectrumCallback = callback;
+    callbackActive = true;
+    callbackThread = std::thread(&Spectrometer::callbackLoop, this);
+    return true;
+}
+
+//! body of callbackThread: hands each frame to the callback until 
+//! acquisition has stopped and the ring is drained
+void WasatchVCPP::Spectrometer::callbackLoop()
+{
+    inSpectrumCallback = true;
+    while (ring.waitForFrame(-1))
+    {
+        // a readNextSpectrum which was already waiting when the callback was
+        // registered may take the frame first
+        std::lock_guard<std::mutex> lock(mutRingConsumer);
+        auto frame = ring.peek();
+        if (frame == nullptr)
+            continue;
+        spectrumCallback(*frame);
+        ring.pop();
+    }
+    callbackActive = false;
+}
+
+//! body of endpointThread: reads endpoints[1..n] whenever acquireSpectrum 
+//! requests, so that they proceed concurrently with endpoints[0]
+void WasatchVCPP::Spectrometer::endpointLoop()
+{
+    std::unique_lock<std::mutex> lock(mutEndpoint);
+    while (true)
+    {
+        cvEndpoint.wait(lock, [this] { return endpointPending || endpointThreadExit; });
+        if (endpointThreadExit)
+            break;
+
+        long timeoutMS = endpointTimeoutMS;
+        lock.unlock();
+
+        bool ok = true;
+        for (int i = 1; ok && i < (int)endpoints.size(); i++)
+            ok = getSubspectrum(i, timeoutMS);
+
+        lock.lock();
+        endpointSuccess = ok;
+        endpointPending = false;
+        cvEndpoint.notify_all();
+    }
+}
+
+//! Fill bufSubspectra[epIndex] from endpoints[epIndex], timing the whole read
+//! (including any retries after timeout) into the endpoint's latency histogram,
+//! and capturing it as one bulk record if recording.
+bool WasatchVCPP::Spectrometer::getSubspectrum(int epIndex, long allocatedMS)
+{
+    uint64_t latencyStart = latency.begin();
+    long long recordStart = recorder != nullptr ? Util::timestampUS() : 0;
+
+    bool ok = readSubspectrum(epIndex, allocatedMS);
+
+    latency.end(LatencyStats::BULK + endpoints[epIndex], latencyStart);
+    if (recorder != nullptr)
+    {
+        const auto& buf = bufSubspectra[epIndex];
+        recorder->record(SessionRecorder::BULK_IN, endpoints[epIndex], 0, 0, ok ? 0 : Transport::ERROR_IO,
+            recordStart, buf.data(), ok ? (int)buf.size() : 0);
+    }
+    return ok;
+}
+
+//! Fill bufSubspectra[epIndex] from endpoints[epIndex].
+//!
+//! Each endpoint has its own buffer (and AsyncBulkReader, if enabled), so 
+//! different endpoints may be read concurrently from different threads.
+//!
+//! @param epIndex (Input) index into endpoints
+//! @param allocatedMS (Input) total time allocated in milliseconds (wall-clock),
+//!        or 0 to wait indefinitely (e.g. for an external trigger)
+//! @returns true if all 'pixelsPerEndpoint' pixels were read
+bool WasatchVCPP::Spectrometer::readSubspectrum(int epIndex, long allocatedMS)
 {
     //! @see https://sourceforge.net/p/libusb-win32/code/HEAD/tree/trunk/libusb/src/windows.c#l493
     //! @see https://sourceforge.net/p/libusb-win32/code/HEAD/tree/trunk/libusb/src/error.h#l41
     const int LIBUSB_WIN32_ERROR_TIMEOUT = -116;
     const int LIBUSB_ERROR_TIMEOUT = -7;
 
-    vector<uint16_t> subspectrum;
+    uint8_t ep = endpoints[epIndex];
+    uint8_t* buf = bufSubspectra[epIndex].data();
+    AsyncBulkReader* asyncReader = asyncReaders.empty() ? nullptr : asyncReaders[epIndex];
 
-    int bytesExpected = (int)bufSubspectrum.size();
+    int bytesExpected = (int)bufSubspectra[epIndex].size();
     int bytesLeftToRead = bytesExpected;
     int totalBytesRead = 0;
 
@@ -693,23 +1761,35 @@ std::vector<uint16_t> WasatchVCPP::Spectrometer::getSubspectrum(uint8_t ep, long
 
     // iterate over multiple reads until we have all this subspectrum's pixels,
     // or we run out of time
+    int attempts = 0;
     while (totalBytesRead < bytesExpected)
     {
-        int timeoutMS = min(periodMS, remainingMS);
+        usbBulkTransfers++;
+        if (attempts++ > 0)
+            usbBulkRetries++;
+
+        int timeoutMS = allocatedMS == 0 ? 0 : (int)min(periodMS, remainingMS);
         auto timeReadStart = std::chrono::high_resolution_clock::now();
 
         logger.debug("attempting to read %d bytes from endpoint 0x%02x with timeout %dms", 
             bytesLeftToRead, ep, timeoutMS);
 
-#if USE_LIBUSB_WIN32
-        int result = 0;
-        int bytesRead = usb_bulk_read(udev, ep, (char*)&bufSubspectrum[0], bytesLeftToRead, timeoutMS);
-#else
         int bytesRead = 0;
-        int result = libusb_bulk_transfer(udev, ep, (unsigned char*)&bufSubspectrum[0], bytesLeftToRead, &bytesRead, timeoutMS);
+        int result = 0;
+        if (asyncReader != nullptr)
+            result = asyncReader->read(ep, buf + totalBytesRead, bytesLeftToRead, &bytesRead, timeoutMS);
+        else
+            result = transport->bulkRead(ep, buf + totalBytesRead, bytesLeftToRead, &bytesRead, timeoutMS);
+
+#if USE_LIBUSB_WIN32
+        // usb_bulk_read reports errors through its return value
+        if (result < 0 && bytesRead == 0)
+            bytesRead = result;
 #endif
 
         logger.debug("read %d bytes from endpoint 0x%02x (result %d)", bytesRead, ep, result);
+        if (bytesRead > 0)
+            usbBulkBytesRead += bytesRead;
 
         // update timing
         auto timeReadEnd = std::chrono::high_resolution_clock::now();
@@ -722,7 +1802,8 @@ std::vector<uint16_t> WasatchVCPP::Spectrometer::getSubspectrum(uint8_t ep, long
         if (operationCancelled)
         {
             logger.error("getSubspectrum: cancellation detected");
-            return vector<uint16_t>();
+            usbCancellations++;
+            return false;
         }
 
         // did an error occur?
@@ -731,6 +1812,8 @@ std::vector<uint16_t> WasatchVCPP::Spectrometer::getSubspectrum(uint8_t ep, long
             // was it a timeout?
             if (bytesRead == LIBUSB_WIN32_ERROR_TIMEOUT || result == LIBUSB_ERROR_TIMEOUT)
             {
+                usbBulkTimeouts++;
+
                 // do we still have time to spend on this?
                 if (remainingMS > 0)
                 {
@@ -749,24 +1832,21 @@ std::vector<uint16_t> WasatchVCPP::Spectrometer::getSubspectrum(uint8_t ep, long
                 libusb_strerror(libusb_error(result))
 #endif
             );
-            return vector<uint16_t>();
+            usbBulkFailures++;
+            return false;
         }
 
         // doesn't seem worth supporting this case; doubt it occurs
         if (bytesRead % 2 != 0)
         {
             logger.error("getSubspectrum: read odd number of bytes (%d)", bytesRead);
-            return vector<uint16_t>();
+            usbBulkOddReads++;
+            usbBulkFailures++;
+            return false;
         }
 
-        ////////////////////////////////////////////////////////////////////////
-        // we received aligned data, so demarshall
-        ////////////////////////////////////////////////////////////////////////
-
-        // demarshal little-endian pixels
-        for (int i = 0; i + 1 < bytesRead; i += 2)
-            subspectrum.push_back(bufSubspectrum[i] | (bufSubspectrum[i + 1] << 8));
-
+        // we received aligned data, which stays in buf until all endpoints
+        // have been read
         totalBytesRead += bytesRead;
         bytesLeftToRead -= bytesRead;
 
@@ -775,7 +1855,7 @@ std::vector<uint16_t> WasatchVCPP::Spectrometer::getSubspectrum(uint8_t ep, long
                 totalBytesRead, bytesLeftToRead);
     }
 
-    return subspectrum;
+    return true;
 }
 
 unsigned long WasatchVCPP::Spectrometer::getIntegrationTimeMS()
@@ -834,83 +1914,6 @@ int WasatchVCPP::Spectrometer::getDetectorTECSetpointDegC()
 bool WasatchVCPP::Spectrometer::getHighGainModeEnable()
 { return isInGaAs() ? ParseData::toBool(getCmd(0xec, 1)) : false; }
 
-////////////////////////////////////////////////////////////////////////////////
-// Post-Processing
-////////////////////////////////////////////////////////////////////////////////
-
-//! Averages over bad pixels in-place.
-void WasatchVCPP::Spectrometer::correctBadPixels(std::vector<double>& spectrum)
-{
-    int pixels = (int)spectrum.size();
-    for (int i = 0; i < eeprom.badPixelsVector.size(); i++)
-    {
-        auto badPix = eeprom.badPixelsVector[i];
-
-        if (badPix < 0)
-            continue;
-
-        if (badPix == 0)
-        {
-            // handle left edge
-            auto nextGood = badPix + 1;
-            while (eeprom.badPixelsSet.count(nextGood) && nextGood < pixels)
-            {
-                nextGood++;
-                i++;
-            }
-            if (nextGood < pixels)
-                for (int j = 0; j < nextGood; j++)
-                    spectrum[j] = spectrum[nextGood];
-        }
-        else
-        {
-            // find previous good pixel
-            auto prevGood = badPix - 1;
-            while (eeprom.badPixelsSet.count(prevGood) && prevGood >= 0)
-                prevGood -= 1;
-
-            if (prevGood >= 0) 
-            {
-                // find next good pixel
-                auto nextGood = badPix + 1;
-                while (eeprom.badPixelsSet.count(nextGood) && nextGood < pixels)
-                {
-                    nextGood++;
-                    i++;
-                }
-
-                if (nextGood < pixels)
-                {
-                    // draw a line between prevGood and nextGood intensity
-                    float deltaIntensity = spectrum[nextGood] - spectrum[prevGood];
-                    int rangePix = nextGood - prevGood;
-                    float intensityPerPix = deltaIntensity / rangePix;
-                    for (int j = 0; j < rangePix - 1; j++)
-                        spectrum[prevGood + j + 1] = spectrum[prevGood] + intensityPerPix * (j + 1);
-                }
-                else
-                {
-                    // we ran off the high end, so copy-right
-                    for (int j = badPix; j < pixels; j++)
-                        spectrum[j] = spectrum[prevGood];
-                }
-            }
-        }
-    }
-}
-
-//! perform 2x2 binning for Bayer filters
-std::vector<double> WasatchVCPP::Spectrometer::bin2x2(const std::vector<double> spectrum)
-{
-    vector<double> binned;
-    int pixels = (int)spectrum.size();
-    for (int i = 0; i < pixels - 1; i++)
-        binned.push_back((spectrum[i] + spectrum[i + 1]) / 2.0);
-    binned.push_back(spectrum[pixels - 1]);
-
-    return binned;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 // Control Messages
 ////////////////////////////////////////////////////////////////////////////////
@@ -947,20 +1950,27 @@ int WasatchVCPP::Spectrometer::sendCmd(uint8_t bRequest, uint16_t wValue, uint16
         len = sizeof(buf);
     }
 
+    // (only formatted if it will be logged, as ACQUIRE carries a payload on ARM)
     string dataStr;
-    if (len > 0)
+    if (len > 0 && logger.level <= Logger::Levels::LOG_LEVEL_DEBUG)
         dataStr = Util::sprintf(" (data: %s)", Util::toHex(data, len).c_str());
 
+    // latency includes waiting for the comm lock, as that's where collisions show
+    uint64_t latencyStart = latency.begin();
     if (!lockComm())
         return -1;
 
-#if USE_LIBUSB_WIN32
-    int bytesWritten = usb_control_msg        (udev, HOST_TO_DEVICE, bRequest, wValue, wIndex, (char*)data, len, maxTimeoutMS);
-#else
-    int bytesWritten = libusb_control_transfer(udev, HOST_TO_DEVICE, bRequest, wValue, wIndex,        data, len, maxTimeoutMS);
-#endif
+    long long recordStart = recorder != nullptr ? Util::timestampUS() : 0;
+    int bytesWritten = transport->controlWrite(bRequest, wValue, wIndex, data, len, maxTimeoutMS);
+    if (recorder != nullptr)
+        recorder->record(SessionRecorder::CONTROL_OUT, bRequest, wValue, wIndex, bytesWritten, recordStart, data, len);
 
     unlockComm();
+    latency.end(LatencyStats::controlKey(bRequest, wValue), latencyStart);
+
+    usbControlTransfers++;
+    if (bytesWritten < 0)
+        usbControlFailures++;
 
     logger.debug("sendCmd(bRequest 0x%02x, wValue 0x%04x, wIndex 0x%04x, len %d, timeout %dms)%s (wrote %d bytes)", 
         bRequest, wValue, wIndex, len, maxTimeoutMS, dataStr.c_str(), bytesWritten);
@@ -1045,19 +2055,24 @@ vector<uint8_t> WasatchVCPP::Spectrometer::getCmdReal(
     // this is our temporary (often somewhat larger) buffer
     vector<uint8_t> data(bytesToRead); 
 
+    uint64_t latencyStart = latency.begin();
     if (!lockComm())
         return retval;
 
     logger.debug("getCmdReal(bRequest 0x%02x, wValue 0x%04x, wIndex 0x%04x, len %d, timeout %dms)", 
         bRequest, wValue, wIndex, bytesToRead, maxTimeoutMS);
 
-#if USE_LIBUSB_WIN32
-    int bytesRead = usb_control_msg        (udev, DEVICE_TO_HOST, bRequest, wValue, wIndex, (char*)&data[0], (int)data.size(), maxTimeoutMS);
-#else
-    int bytesRead = libusb_control_transfer(udev, DEVICE_TO_HOST, bRequest, wValue, wIndex,        &data[0], (int)data.size(), maxTimeoutMS);
-#endif
+    long long recordStart = recorder != nullptr ? Util::timestampUS() : 0;
+    int bytesRead = transport->controlRead(bRequest, wValue, wIndex, &data[0], (int)data.size(), maxTimeoutMS);
+    if (recorder != nullptr)
+        recorder->record(SessionRecorder::CONTROL_IN, bRequest, wValue, wIndex, bytesRead, recordStart, &data[0], bytesRead);
 
     unlockComm();
+    latency.end(LatencyStats::controlKey(bRequest, wValue), latencyStart);
+
+    usbControlTransfers++;
+    if (bytesRead < len)
+        usbControlFailures++;
 
     logger.debug("getCmdReal(0x%02x): read %d bytes: %s", bRequest, bytesRead, Util::toHex(data).c_str());
 
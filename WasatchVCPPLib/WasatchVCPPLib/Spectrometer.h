@@ -7,24 +7,28 @@
 
 #pragma once
 
-#ifdef USE_LIBUSB_WIN32
-#include "libusb.h"
-#define WPVCPP_UDEV_TYPE usb_dev_handle
-#else
-//#include <libusb-1_0.h>
-#include <libusb.h>
-#define WPVCPP_UDEV_TYPE libusb_device_handle
-#endif
-
 #include "EEPROM.h"
 #include "Logger.h"
+#include "SpectrumRing.h"
+#include "ProcessingPipeline.h"
+#include "PeakFinder.h"
+#include "PeakFitter.h"
+#include "LatencyStats.h"
+#include "UsbStats.h"
+#include "Transport.h"
+#include "SessionRecorder.h"
 
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
 
 namespace WasatchVCPP
 {
     class Driver;
+    class AsyncBulkReader;
 
 
     //! Internal class encapsulating state and control of one spectrometer.
@@ -46,22 +50,50 @@ namespace WasatchVCPP
                 InsufficientStorage = -3,
                 NoLaser             = -4,
                 NotInGaAs           = -5,
+                NoCalibration       = -6,
+                Timeout             = -7,
+                Busy                = -8,
                 InvalidGain         = -256,
                 InvalidTemperature  = -999,
                 InvalidOffset       = -32768 
             };
 
-            Spectrometer(WPVCPP_UDEV_TYPE* udev, int pid, int index, Logger& logger);
+            //! The circumstances of one acquired spectrum.  Everything is either
+            //! timed or counted during acquisition, or cached from the last 
+            //! setter (or getter) call, so no extra USB traffic is needed.
+            struct Metadata
+            {
+                long long triggerTimestampUS = 0;   //!< ACQUIRE sent for the (first) scan (0 if externally triggered)
+                long long receiveTimestampUS = 0;   //!< last byte received
+                uint64_t sequence = 0;              //!< acquisitions attempted before this one
+                uint64_t drops = 0;                 //!< acquisitions which failed, or were discarded (cumulative)
+                unsigned long integrationTimeMS = 0;
+                int scansAveraged = 1;
+                float detectorGain = 0;
+                int detectorOffset = 0;
+                bool laserEnabled = false;
+                float laserPowerPerc = 0;
+                float detectorTemperatureDegC = 0;  //!< last read
+            };
+
+            //! receives each spectrum acquired in continuous mode
+            typedef std::function<void(const SpectrumRing::Frame& frame)> SpectrumCallback;
+
+            Spectrometer(Transport* transport, int pid, int index, Logger& logger, SessionRecorder* recorder = nullptr);
             ~Spectrometer();
 
             bool close();
 
             EEPROM eeprom;
+            ProcessingPipeline pipeline;
+            PeakFitter peakFitter;
+            LatencyStats latency;         //!< per-opcode / per-endpoint USB timing
             Driver* driver = nullptr;     // still needed?
 
             // public metadata
             int pid = 0;
             int index = -1;
+            int bus = -1;                 //!< USB bus number (set by Driver)
             std::vector<double> wavelengths;
             std::vector<double> wavenumbers;
             bool isARM();
@@ -85,7 +117,11 @@ namespace WasatchVCPP
             std::string firmwareVersion;
             std::string fpgaVersion;
             int integrationTimeMS = 1;
+            float detectorGain = 0;
+            int detectorOffset = 0;
+            float lastDetectorTemperatureDegC = ErrorCodes::InvalidTemperature;
             bool laserEnabled = false;
+            float laserPowerPerc = 0;
             bool laserPowerHighResolution = true;
             bool laserPowerRequireModulation = false;
             bool modEnabled = false;
@@ -93,6 +129,7 @@ namespace WasatchVCPP
             float modPeriodus = 0.0;
             int detectorTECSetointDegC = ErrorCodes::InvalidTemperature;
             bool srm_in_EEPROM = false;
+            std::vector<double> ramanIntensityFactors; //!< per-pixel SRM factors (empty if uncalibrated)
 
             // opcodes
             bool setIntegrationTimeMS(unsigned long ms);
@@ -104,6 +141,7 @@ namespace WasatchVCPP
             bool setDetectorTECEnable(bool flag);
             bool setDetectorTECSetpointDegC(int value);
             bool setHighGainModeEnable(bool flag);
+            bool setTriggerSource(bool external);
             bool setLaserPowerPerc(float percent);
             std::string getFirmwareVersion();
             std::string getFPGAVersion();
@@ -131,26 +169,120 @@ namespace WasatchVCPP
 
             // acquisition
             std::vector<double> getSpectrum();
+            bool getSpectrum(double* spectrum, int len, bool sendTrigger = true);
+            bool getSpectrum(float* spectrum, int len, bool sendTrigger = true);
+            bool getSpectrum(double* spectrum, int len, Metadata& metadata);
+            bool getSpectrumRaw(uint16_t* spectrum, int len, bool postProcess);
+            int getSpectrumLength();
+            int setOutputAxis(double start, double step, int count, bool wavenumber);
+
+            // peakfinding
+            int findPeaks(const double* spectrum, int len, const PeakFinder::Params& params, int maxPeaks, std::vector<PeakFinder::Peak>& peaks);
+            int getSpectrumPeaks(const PeakFinder::Params& params, int maxPeaks, std::vector<PeakFinder::Peak>& peaks);
+            int fitPeaks(const double* spectrum, int len, PeakFitter::Shape shape, const std::vector<PeakFitter::Guess>& guesses, std::vector<PeakFitter::Fit>& fits);
+
+            // dark and reference
+            bool storeDark();
+            bool storeReference();
+
             bool cancelOperation(bool blocking);
+            bool sendSoftwareTrigger();
+            bool setScansToAverage(int n);
+            int getScansToAverage();
+            double getRamanIntensityFactor(int pixel);
+            long long getLastTriggerTimestampUS();
+            long long getLastReceiveTimestampUS();
+            bool setAsyncBulkTransfers(int count);
+            int getAsyncBulkTransfers();
+            UsbStats getUsbStats();
+
+            // continuous acquisition
+            bool startContinuous(int depth, bool triggered = false);
+            bool stopContinuous();
+            bool isContinuous();
+            bool isTriggered();
+            int readNextSpectrum(double* spectrum, int len, int timeoutMS, long long* timestampUS = nullptr);
+            uint64_t getContinuousOverruns();
+            bool setSpectrumCallback(const SpectrumCallback& callback, int depth);
 
         ////////////////////////////////////////////////////////////////////////
         // Private attributes
         ////////////////////////////////////////////////////////////////////////
         private:
-            WPVCPP_UDEV_TYPE* udev = nullptr;
+            Transport* transport = nullptr;     //!< owned
+            SessionRecorder* recorder = nullptr; //!< owned (null unless capturing)
 
             std::vector<uint8_t> endpoints;
-            std::vector<uint8_t> bufSubspectrum; 
+            std::vector<std::vector<uint8_t> > bufSubspectra;   //!< one per endpoint
             int pixelsPerEndpoint = 0;
+            std::vector<AsyncBulkReader*> asyncReaders;         //!< one per endpoint (empty for blocking reads)
+
+            // reads endpoints after the first concurrently with it
+            std::thread endpointThread;
+            std::mutex mutEndpoint;
+            std::condition_variable cvEndpoint;
+            bool endpointPending = false;
+            bool endpointSuccess = false;
+            bool endpointThreadExit = false;
+            long endpointTimeoutMS = 0;
 
             bool detectorTECSetpointHasBeenSet = false;
             bool acquiring = false;
             bool operationCancelled = false;
             int cancelledIntegrationTimeMS = 0;
             bool lastAcquisitionWasCancelled = false;
+            std::atomic<long long> lastTriggerTimestampUS{0};
+            std::atomic<long long> lastReceiveTimestampUS{0};
+            uint64_t acquisitionCount = 0;                  //!< guarded by mutAcquisition
+            std::atomic<uint64_t> droppedSpectra{0};
+
+            // see UsbStats (atomic, as endpoints are read from several threads)
+            std::atomic<uint64_t> usbBulkBytesRead{0};
+            std::atomic<uint64_t> usbBulkTransfers{0};
+            std::atomic<uint64_t> usbBulkTimeouts{0};
+            std::atomic<uint64_t> usbBulkRetries{0};
+            std::atomic<uint64_t> usbBulkOddReads{0};
+            std::atomic<uint64_t> usbBulkFailures{0};
+            std::atomic<uint64_t> usbCancellations{0};
+            std::atomic<uint64_t> usbControlTransfers{0};
+            std::atomic<uint64_t> usbControlFailures{0};
+            int scansToAverage = 1;
+            std::vector<uint32_t> accumulator;  //!< sized only while scansToAverage > 1
+            std::mutex mutOutputAxis;           //!< guards the output axis
+            double outputAxisStart = 0;
+            double outputAxisStep = 0;
+            bool outputAxisWavenumber = false;
+
+            PeakFinder peakFinder;
+            std::vector<double> peakSpectrum;   //!< acquired by getSpectrumPeaks
+            std::mutex mutPeaks;
+
+            //! maps positions within a spectrum from getSpectrum onto nm and cm-1
+            struct PeakAxis
+            {
+                bool resampled = false;
+                double start = 0;
+                double step = 0;
+                bool wavenumber = false;
+            };
+            bool getPeakAxis(int len, PeakAxis& axis);
+            void locatePeak(const PeakAxis& axis, double pixel, double& wavelength, double& wavenumber);
 
             std::mutex mutAcquisition;
             std::mutex mutComm;
+            std::mutex mutAsyncReader;
+
+            SpectrumRing ring;
+            std::thread continuousThread;
+            std::atomic<bool> continuousRunning{false};
+            std::atomic<bool> continuousExited{true};
+            std::atomic<bool> externalTrigger{false};   //!< continuousThread is waiting on the trigger input
+            std::mutex mutContinuous;   //!< serializes start / stop
+            std::mutex mutRingConsumer; //!< the ring only supports one reader at a time
+
+            SpectrumCallback spectrumCallback;
+            std::thread callbackThread;         //!< consumes the ring while a callback is registered
+            std::atomic<bool> callbackActive{false};
 
             Logger& logger;
 
@@ -160,14 +292,25 @@ namespace WasatchVCPP
         private:
             // initialization
             bool readEEPROM();
+            void cacheRamanIntensityFactors();
 
             // acquisition 
-            std::vector<uint16_t> getSubspectrum(uint8_t ep, long allocatedMS);
+            template<typename T> bool getProcessedSpectrum(T* spectrum, int len, bool sendTrigger, Metadata* metadata = nullptr);
+            template<typename T> bool acquireSpectrum(T* spectrum, int len, bool sendTrigger, bool invert, const float* linearityLUT = nullptr, Metadata* metadata = nullptr);
+            bool triggerAcquisition();
+            bool readSubspectra();
+            template<typename T> void demarshal(T* spectrum, bool invert, const float* linearityLUT);
+            void accumulate();
+            template<typename T> void average(T* spectrum, int scans, bool invert, const float* linearityLUT);
+            void average(uint16_t* spectrum, int scans, bool invert, const float* linearityLUT);
+            bool getSubspectrum(int epIndex, long allocatedMS);
+            bool readSubspectrum(int epIndex, long allocatedMS);
+            void abortRead();
             long generateTotalWaitMS();
-
-            // post-processing
-            std::vector<double> bin2x2(const std::vector<double> spectrum);
-            void correctBadPixels(std::vector<double>& spectrum);
+            bool launchContinuous(int depth, bool triggered);
+            void continuousLoop();
+            void callbackLoop();
+            void endpointLoop();
 
             // control messages
             int sendCmd(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, std::vector<uint8_t> data);
@@ -0,0 +1,130 @@
+/**
+    @file   SpectrumRing.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::SpectrumRing
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "SpectrumRing.h"
+
+#include <chrono>
+
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+
+//! (Re)allocate all frames.  Only call while neither producer nor consumer
+//! is running.
+bool WasatchVCPP::SpectrumRing::init(int depth, int pixels)
+{
+    if (depth < 1 || pixels < 1)
+        return false;
+
+    frames.resize(depth);
+    for (auto& frame : frames)
+        frame.spectrum.assign(pixels, 0.0);
+
+    clear();
+    return true;
+}
+
+void WasatchVCPP::SpectrumRing::clear()
+{
+    head = 0;
+    tail = 0;
+    overruns = 0;
+
+    lock_guard<mutex> lock(mutWait);
+    woken = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Producer
+////////////////////////////////////////////////////////////////////////////////
+
+//! @returns the next free slot, or nullptr if the consumer has fallen a full
+//!          ring behind
+WasatchVCPP::SpectrumRing::Frame* WasatchVCPP::SpectrumRing::beginWrite()
+{
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= frames.size())
+        return nullptr;
+    return &frames[h % frames.size()];
+}
+
+//! publish the slot returned by beginWrite()
+void WasatchVCPP::SpectrumRing::endWrite()
+{
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // the empty critical section ensures a consumer between checking its
+    // predicate and sleeping can't miss the notification
+    { lock_guard<mutex> lock(mutWait); }
+
+    // all, as a reader already waiting when a spectrum callback is registered
+    // may briefly wait alongside the callback thread (they then take turns
+    // through Spectrometer::mutRingConsumer)
+    cvWait.notify_all();
+}
+
+//! count a frame the producer had to discard because the ring was full
+void WasatchVCPP::SpectrumRing::addOverrun() { overruns++; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Consumer
+////////////////////////////////////////////////////////////////////////////////
+
+//! @returns the oldest unread frame, or nullptr if empty
+WasatchVCPP::SpectrumRing::Frame* WasatchVCPP::SpectrumRing::peek()
+{
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+        return nullptr;
+    return &frames[t % frames.size()];
+}
+
+//! release the frame returned by peek() back to the producer
+void WasatchVCPP::SpectrumRing::pop()
+{
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//! Block until a frame is available, wake() is called, or timeoutMS elapses.
+//!
+//! @param timeoutMS (Input) 0 to poll, negative to wait indefinitely
+//! @returns true if a frame is available
+bool WasatchVCPP::SpectrumRing::waitForFrame(int timeoutMS)
+{
+    if (peek() != nullptr)
+        return true;
+    if (timeoutMS == 0)
+        return false;
+
+    unique_lock<mutex> lock(mutWait);
+    auto ready = [this] { return woken || tail.load() != head.load(); };
+    if (timeoutMS < 0)
+        cvWait.wait(lock, ready);
+    else
+        cvWait.wait_for(lock, std::chrono::milliseconds(timeoutMS), ready);
+
+    return peek() != nullptr;
+}
+
+//! release any consumer blocked in waitForFrame (e.g. the producer has stopped)
+void WasatchVCPP::SpectrumRing::wake()
+{
+    {
+        lock_guard<mutex> lock(mutWait);
+        woken = true;
+    }
+    cvWait.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Accessors
+////////////////////////////////////////////////////////////////////////////////
+
+int WasatchVCPP::SpectrumRing::getDepth() { return (int)frames.size(); }
+int WasatchVCPP::SpectrumRing::size() { return (int)(head.load() - tail.load()); }
+uint64_t WasatchVCPP::SpectrumRing::getOverruns() { return overruns.load(); }
@@ -0,0 +1,69 @@
+/**
+    @file   SpectrumRing.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::SpectrumRing
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace WasatchVCPP
+{
+    //! Internal single-producer / single-consumer ring of preallocated spectra,
+    //! used by continuous acquisition.
+    //!
+    //! The producer (the Spectrometer's acquisition thread) and the consumer
+    //! (whichever thread calls wp_read_next_spectrum) never share a lock:
+    //! ownership of each slot is handed back and forth through the atomic
+    //! head and tail counters.  The mutex / condition variable are only used
+    //! to put an idle consumer to sleep, never to guard the data.
+    //!
+    //! Frames are never reallocated once init() has sized them, so a slot
+    //! obtained from beginWrite() or peek() can be written or read in place.
+    class SpectrumRing
+    {
+        public:
+            struct Frame
+            {
+                std::vector<double> spectrum;
+                uint64_t sequence = 0;      //!< acquisition count (gaps indicate overruns)
+                long long timestampUS = 0;  //!< when the host received it (Util::timestampUS)
+            };
+
+            bool init(int depth, int pixels);
+            void clear();
+
+            // producer
+            Frame* beginWrite();
+            void endWrite();
+            void addOverrun();
+
+            // consumer
+            Frame* peek();
+            void pop();
+            bool waitForFrame(int timeoutMS);
+
+            void wake();
+
+            int getDepth();
+            int size();
+            uint64_t getOverruns();
+
+        private:
+            std::vector<Frame> frames;
+
+            std::atomic<uint64_t> head{0}; //!< total frames written (producer-owned)
+            std::atomic<uint64_t> tail{0}; //!< total frames read (consumer-owned)
+            std::atomic<uint64_t> overruns{0};
+
+            std::mutex mutWait;
+            std::condition_variable cvWait;
+            bool woken = false;
+    };
+}
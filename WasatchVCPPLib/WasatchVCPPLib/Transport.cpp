@@ -0,0 +1,33 @@
+/**
+    @file   Transport.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::Transport
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "Transport.h"
+
+WasatchVCPP::Transport::~Transport()
+{
+}
+
+//! @returns a reader keeping several bulk transfers in flight, or nullptr
+//!          if the transport only supports blocking reads (the default)
+WasatchVCPP::AsyncBulkReader* WasatchVCPP::Transport::createAsyncReader(int /* transfers */, Logger& /* logger */)
+{
+    return nullptr;
+}
+
+//! Abort any blocking bulkRead in progress, if the transport is able to
+//! (blocking libusb reads are not).
+void WasatchVCPP::Transport::cancel()
+{
+}
+
+//! @returns true if cancel() interrupts a blocking bulkRead (else only 
+//!          asynchronous reads can be abandoned)
+bool WasatchVCPP::Transport::isCancellable()
+{
+    return false;
+}
@@ -0,0 +1,56 @@
+/**
+    @file   Transport.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::Transport
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include "Logger.h"
+
+#include <cstdint>
+
+namespace WasatchVCPP
+{
+    class AsyncBulkReader;
+
+    //! Internal interface through which a Spectrometer exchanges USB 
+    //! transfers with its device.
+    //!
+    //! UsbTransport wraps a real libusb (or libusb-win32) handle;
+    //! SimulatedDevice answers in-process, so everything above this layer
+    //! can be exercised without hardware.
+    //!
+    //! Result codes follow libusb-1.0 (negative on error), so callers see
+    //! the same values whichever implementation is underneath.  Control 
+    //! transfers are serialized by the caller, but bulk reads of different
+    //! endpoints may run concurrently with them and with each other.
+    class Transport
+    {
+        public:
+            static const int ERROR_IO = -1;             //!< LIBUSB_ERROR_IO
+            static const int ERROR_TIMEOUT = -7;        //!< LIBUSB_ERROR_TIMEOUT
+            static const int ERROR_PIPE = -9;           //!< LIBUSB_ERROR_PIPE (endpoint stalled / opcode unsupported)
+            static const int ERROR_INTERRUPTED = -10;   //!< LIBUSB_ERROR_INTERRUPTED
+
+            virtual ~Transport();
+
+            //! @returns bytes written, or negative on error
+            virtual int controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS) = 0;
+
+            //! @returns bytes read into data, or negative on error
+            virtual int controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS) = 0;
+
+            //! Read up to len bytes from a bulk endpoint, as libusb_bulk_transfer.
+            //!
+            //! @param bytesRead (Output) bytes actually read
+            //! @param timeoutMS (Input) 0 to wait indefinitely
+            //! @returns 0 on success, or negative on error
+            virtual int bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS) = 0;
+
+            virtual AsyncBulkReader* createAsyncReader(int transfers, Logger& logger);
+            virtual void cancel();
+            virtual bool isCancellable();
+    };
+}
@@ -0,0 +1,23 @@
+/**
+    @file   UsbStats.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::UsbStats
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "UsbStats.h"
+
+//! Accumulate another snapshot (e.g. summing a bus's spectrometers).
+void WasatchVCPP::UsbStats::add(const UsbStats& other)
+{
+    bulkBytesRead    += other.bulkBytesRead;
+    bulkTransfers    += other.bulkTransfers;
+    bulkTimeouts     += other.bulkTimeouts;
+    bulkRetries      += other.bulkRetries;
+    bulkOddReads     += other.bulkOddReads;
+    bulkFailures     += other.bulkFailures;
+    cancellations    += other.cancellations;
+    controlTransfers += other.controlTransfers;
+    controlFailures  += other.controlFailures;
+}
@@ -0,0 +1,34 @@
+/**
+    @file   UsbStats.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::UsbStats
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace WasatchVCPP
+{
+    //! Internal snapshot of cumulative USB transfer counts, for one 
+    //! Spectrometer (since opened) or one bus (since the Driver first opened
+    //! a spectrometer on it).
+    //!
+    //! Bulk counts cover spectral reads; "transfers" are individual read 
+    //! attempts, of which one subspectrum may take several.
+    struct UsbStats
+    {
+        uint64_t bulkBytesRead = 0;
+        uint64_t bulkTransfers = 0;
+        uint64_t bulkTimeouts = 0;      //!< transfers which timed out (whether or not retried)
+        uint64_t bulkRetries = 0;       //!< transfers after the first for one endpoint's subspectrum
+        uint64_t bulkOddReads = 0;      //!< transfers returning an odd number of bytes (abandoned)
+        uint64_t bulkFailures = 0;      //!< subspectra abandoned on error or timeout
+        uint64_t cancellations = 0;     //!< subspectra abandoned by cancelOperation
+        uint64_t controlTransfers = 0;
+        uint64_t controlFailures = 0;   //!< control transfers failing, or returning too few bytes
+
+        void add(const UsbStats& other);
+    };
+}
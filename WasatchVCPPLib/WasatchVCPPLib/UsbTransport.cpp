@@ -0,0 +1,71 @@
+/**
+    @file   UsbTransport.cpp
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  implementation of WasatchVCPP::UsbTransport
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#include "pch.h"
+#include "UsbTransport.h"
+#include "AsyncBulkReader.h"
+
+const int HOST_TO_DEVICE = 0x40;
+const int DEVICE_TO_HOST = 0xC0;
+
+WasatchVCPP::UsbTransport::UsbTransport(WPVCPP_UDEV_TYPE* udev, Logger& logger)
+    : udev(udev), logger(logger)
+{
+}
+
+WasatchVCPP::UsbTransport::~UsbTransport()
+{
+#if USE_LIBUSB_WIN32
+    usb_release_interface(udev, 0);
+    usb_close(udev);
+#else
+    logger.info("UsbTransport: releasing interface on Linux");
+    libusb_release_interface(udev, 0);
+    libusb_close(udev);
+#endif
+}
+
+int WasatchVCPP::UsbTransport::controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS)
+{
+#if USE_LIBUSB_WIN32
+    return usb_control_msg        (udev, HOST_TO_DEVICE, bRequest, wValue, wIndex, (char*)data, len, timeoutMS);
+#else
+    return libusb_control_transfer(udev, HOST_TO_DEVICE, bRequest, wValue, wIndex,        data, len, timeoutMS);
+#endif
+}
+
+int WasatchVCPP::UsbTransport::controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS)
+{
+#if USE_LIBUSB_WIN32
+    return usb_control_msg        (udev, DEVICE_TO_HOST, bRequest, wValue, wIndex, (char*)data, len, timeoutMS);
+#else
+    return libusb_control_transfer(udev, DEVICE_TO_HOST, bRequest, wValue, wIndex,        data, len, timeoutMS);
+#endif
+}
+
+//! On libusb-win32, usb_bulk_read's negative byte count (e.g. -116 on 
+//! timeout) is passed through as the result code.
+int WasatchVCPP::UsbTransport::bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS)
+{
+#if USE_LIBUSB_WIN32
+    int result = usb_bulk_read(udev, ep, (char*)data, len, timeoutMS);
+    if (result < 0)
+    {
+        *bytesRead = 0;
+        return result;
+    }
+    *bytesRead = result;
+    return 0;
+#else
+    return libusb_bulk_transfer(udev, ep, data, len, bytesRead, timeoutMS);
+#endif
+}
+
+WasatchVCPP::AsyncBulkReader* WasatchVCPP::UsbTransport::createAsyncReader(int transfers, Logger& logger)
+{
+    return new AsyncBulkReader(udev, transfers, logger);
+}
@@ -0,0 +1,41 @@
+/**
+    @file   UsbTransport.h
+    @author Mark Zieg <mzieg@wasatchphotonics.com>
+    @brief  interface of WasatchVCPP::UsbTransport
+    @note   customers normally wouldn't access this file; use WasatchVCPP.h instead
+*/
+
+#pragma once
+
+#ifdef USE_LIBUSB_WIN32
+#include "libusb.h"
+#define WPVCPP_UDEV_TYPE usb_dev_handle
+#else
+//#include <libusb-1_0.h>
+#include <libusb.h>
+#define WPVCPP_UDEV_TYPE libusb_device_handle
+#endif
+
+#include "Transport.h"
+
+namespace WasatchVCPP
+{
+    //! Internal Transport over an opened and claimed USB device handle, 
+    //! which it releases and closes on destruction.
+    class UsbTransport : public Transport
+    {
+        public:
+            UsbTransport(WPVCPP_UDEV_TYPE* udev, Logger& logger);
+            ~UsbTransport();
+
+            int controlWrite(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS);
+            int controlRead(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t* data, int len, int timeoutMS);
+            int bulkRead(uint8_t ep, uint8_t* data, int len, int* bytesRead, int timeoutMS);
+
+            AsyncBulkReader* createAsyncReader(int transfers, Logger& logger);
+
+        private:
+            WPVCPP_UDEV_TYPE* udev = nullptr;
+            Logger& logger;
+    };
+}
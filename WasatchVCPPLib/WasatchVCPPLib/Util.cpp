@@ -11,6 +11,8 @@
 #include <time.h>
 #include <stdarg.h>
 
+#include <chrono>
+
 using std::string;
 using std::set;
 
@@ -68,6 +70,14 @@ string WasatchVCPP::Util::timestamp()
 #endif
 }
 
+//! monotonic microseconds since an arbitrary epoch (for measuring intervals,
+//! not wall-clock time)
+long long WasatchVCPP::Util::timestampUS()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void WasatchVCPP::Util::sleepMS(int ms)
 {
 #ifdef _WINDOWS
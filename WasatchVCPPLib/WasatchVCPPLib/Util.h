@@ -25,6 +25,7 @@ namespace WasatchVCPP
             static std::string toHex(const uint8_t* data, int len);
             static std::string toLower(const std::string& s);
             static std::string timestamp();
+            static long long timestampUS();
             static void sleepMS(int ms);
 
             //! Joins an iterable containter to a delimited string.
@@ -34,7 +34,14 @@
 using WasatchVCPP::Util;
 using WasatchVCPP::Driver;
 using WasatchVCPP::Spectrometer;
+using WasatchVCPP::ProcessingPipeline;
+using WasatchVCPP::BaselineRemover;
+using WasatchVCPP::SavitzkyGolay;
+using WasatchVCPP::PeakFinder;
+using WasatchVCPP::PeakFitter;
+using WasatchVCPP::SpectrumRing;
 using WasatchVCPP::Logger;
+using WasatchVCPP::UsbStats;
 
 using std::string;
 using std::vector;
@@ -52,6 +59,21 @@ static unsigned long delay_us = 0;
 // helper functions
 ////////////////////////////////////////////////////////////////////////////////
 
+//! copy internal USB counters to the exported struct
+void exportUsbStats(const UsbStats& stats, int bus, WPUsbStats* out)
+{
+    out->bus              = bus;
+    out->bulkBytesRead    = stats.bulkBytesRead;
+    out->bulkTransfers    = stats.bulkTransfers;
+    out->bulkTimeouts     = stats.bulkTimeouts;
+    out->bulkRetries      = stats.bulkRetries;
+    out->bulkOddReads     = stats.bulkOddReads;
+    out->bulkFailures     = stats.bulkFailures;
+    out->cancellations    = stats.cancellations;
+    out->controlTransfers = stats.controlTransfers;
+    out->controlFailures  = stats.controlFailures;
+}
+
 //! copy a std::string to a C string
 //!
 //! @param s (Input) a populated std::string
@@ -104,6 +126,60 @@ void wp_destroy_driver()
     driver->destroy();
 }
 
+int wp_set_simulated_spectrometers(int count, int pixels, float latencyScale)
+{
+    if (count < 0 || pixels < 1 || pixels > 0xffff || !(latencyScale >= 0))
+        return WP_ERROR;
+
+    auto config = driver->getSimulatedSpectrometers();
+    config.count = count;
+    config.pixels = pixels;
+    config.latencyScale = latencyScale;
+    driver->setSimulatedSpectrometers(config);
+    return WP_SUCCESS;
+}
+
+int wp_set_simulated_eeprom(const unsigned char* image, int len)
+{
+    const int pageSize = WasatchVCPP::EEPROM::PAGE_SIZE;
+    const int maxPages = WasatchVCPP::EEPROM::MAX_PAGES;
+
+    auto config = driver->getSimulatedSpectrometers();
+    config.eepromPages.clear();
+    if (image != nullptr)
+    {
+        if (len <= 0 || len % pageSize != 0 || len > pageSize * maxPages)
+            return WP_ERROR;
+        for (int offset = 0; offset < len; offset += pageSize)
+            config.eepromPages.push_back(vector<uint8_t>(image + offset, image + offset + pageSize));
+    }
+    driver->setSimulatedSpectrometers(config);
+    return WP_SUCCESS;
+}
+
+int wp_set_usb_capture(const char* prefix, int len)
+{
+    string s;
+    for (int i = 0; prefix != nullptr && i < len && prefix[i]; i++)
+        s += prefix[i];
+
+    driver->setCapturePrefix(s);
+    return WP_SUCCESS;
+}
+
+int wp_open_replay(const char* pathname, int len, int realTime)
+{
+    if (pathname == nullptr)
+        return WP_ERROR;
+
+    string s;
+    for (int i = 0; i < len && pathname[i]; i++)
+        s += pathname[i];
+
+    int index = driver->openReplay(s, realTime != 0);
+    return index >= 0 ? index : WP_ERROR;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Gettors
 ////////////////////////////////////////////////////////////////////////////////
@@ -118,6 +194,15 @@ int wp_get_number_of_spectrometers()
     return driver->getNumberOfSpectrometers();
 }
 
+int wp_get_spectrum_length(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->getSpectrumLength();
+}
+
 int wp_get_pixels(int specIndex)
 {
     auto spec = driver->getSpectrometer(specIndex);
@@ -217,21 +302,24 @@ int wp_get_spectrum(int specIndex, double* spectrum, int len)
         return WP_ERROR_INVALID_SPECTROMETER;
     }
 
-    auto intensities = spec->getSpectrum();
-    if (intensities.empty())
+    if (spec->isContinuous())
     {
-        driver->logger.error("wp_get_spectrum: error generating spectrum");
-        return WP_ERROR;
+        driver->logger.error("wp_get_spectrum: continuous acquisition is running");
+        return WP_ERROR_BUSY;
     }
 
-    if (len < (int)intensities.size())
+    if (len < spec->getSpectrumLength())
     {
         driver->logger.error("wp_get_spectrum: insufficient storage");
         return WP_ERROR_INSUFFICIENT_STORAGE;
     }
 
-    for (int i = 0; i < (int)intensities.size(); i++)
-        spectrum[i] = intensities[i];
+    // acquire directly into the caller's buffer
+    if (!spec->getSpectrum(spectrum, len))
+    {
+        driver->logger.error("wp_get_spectrum: error generating spectrum");
+        return WP_ERROR;
+    }
 
     delay();
     return WP_SUCCESS;
@@ -246,25 +334,146 @@ int wp_get_spectrum_float(int specIndex, float* spectrum, int len)
         return WP_ERROR_INVALID_SPECTROMETER;
     }
 
-    auto intensities = spec->getSpectrum();
-    if (intensities.empty())
+    if (spec->isContinuous())
+    {
+        driver->logger.error("wp_get_spectrum_float: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    if (len < spec->getSpectrumLength())
+    {
+        driver->logger.error("wp_get_spectrum: insufficient storage");
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+    }
+
+    // acquire directly into the caller's buffer
+    if (!spec->getSpectrum(spectrum, len))
     {
         driver->logger.error("wp_get_spectrum: error generating spectrum");
         return WP_ERROR;
     }
 
-    if (len < (int)intensities.size())
+    return WP_SUCCESS;
+}
+
+int wp_get_spectrum_ex(int specIndex, double* spectrum, int len, WPSpectrumMetadata* metadata)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isContinuous())
     {
-        driver->logger.error("wp_get_spectrum: insufficient storage");
+        driver->logger.error("wp_get_spectrum_ex: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    if (metadata == nullptr || len < spec->getSpectrumLength())
+    {
+        driver->logger.error("wp_get_spectrum_ex: insufficient storage");
         return WP_ERROR_INSUFFICIENT_STORAGE;
     }
 
-    for (int i = 0; i < (int)intensities.size(); i++)
-        spectrum[i] = (float) intensities[i];
+    Spectrometer::Metadata md;
+    if (!spec->getSpectrum(spectrum, len, md))
+    {
+        driver->logger.error("wp_get_spectrum_ex: error generating spectrum");
+        return WP_ERROR;
+    }
+
+    metadata->triggerTimestampUS = md.triggerTimestampUS;
+    metadata->receiveTimestampUS = md.receiveTimestampUS;
+    metadata->sequence = md.sequence;
+    metadata->drops = md.drops;
+    metadata->integrationTimeMS = (int)md.integrationTimeMS;
+    metadata->scansAveraged = md.scansAveraged;
+    metadata->detectorGain = md.detectorGain;
+    metadata->detectorOffset = md.detectorOffset;
+    metadata->laserEnabled = md.laserEnabled ? 1 : 0;
+    metadata->laserPowerPerc = md.laserPowerPerc;
+    metadata->detectorTemperatureDegC = md.detectorTemperatureDegC;
+    return WP_SUCCESS;
+}
+
+int wp_send_software_trigger(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isContinuous())
+        return WP_ERROR_BUSY;
+
+    return spec->sendSoftwareTrigger() ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_read_spectrum(int specIndex, double* spectrum, int len)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+    {
+        driver->logger.error("wp_read_spectrum: invalid specIndex %d", specIndex);
+        return WP_ERROR_INVALID_SPECTROMETER;
+    }
+
+    if (spec->isContinuous())
+    {
+        driver->logger.error("wp_read_spectrum: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    if (len < spec->getSpectrumLength())
+    {
+        driver->logger.error("wp_read_spectrum: insufficient storage");
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+    }
+
+    if (!spec->getSpectrum(spectrum, len, false))
+    {
+        driver->logger.error("wp_read_spectrum: error reading spectrum");
+        return WP_ERROR;
+    }
 
     return WP_SUCCESS;
 }
 
+int wp_acquire_all(double** spectra, const int* lens, long long* triggerTimestampsUS, int count)
+{
+    if (spectra == nullptr || lens == nullptr || triggerTimestampsUS == nullptr || count < 1)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    return driver->acquireAll(spectra, lens, triggerTimestampsUS, count) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_get_spectrum_raw_u16(int specIndex, unsigned short* spectrum, int len, int postProcess)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+    {
+        driver->logger.error("wp_get_spectrum_raw_u16: invalid specIndex %d", specIndex);
+        return WP_ERROR_INVALID_SPECTROMETER;
+    }
+
+    if (spec->isContinuous())
+    {
+        driver->logger.error("wp_get_spectrum_raw_u16: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    if (len < spec->pixels)
+    {
+        driver->logger.error("wp_get_spectrum_raw_u16: insufficient storage");
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+    }
+
+    if (!spec->getSpectrumRaw(spectrum, len, postProcess != 0))
+    {
+        driver->logger.error("wp_get_spectrum_raw_u16: error generating spectrum");
+        return WP_ERROR;
+    }
+
+    return WP_SUCCESS;
+}
 
 int wp_get_eeprom_field_count(int specIndex)
 {
@@ -701,6 +910,141 @@ int wp_get_max_timeout_ms(int specIndex)
     return spec->maxTimeoutMS;
 }
 
+int wp_set_async_bulk_transfers(int specIndex, int count)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isTriggered())
+    {
+        driver->logger.error("wp_set_async_bulk_transfers: triggered acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    return spec->setAsyncBulkTransfers(count) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_get_async_bulk_transfers(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->getAsyncBulkTransfers();
+}
+
+int wp_set_scans_to_average(int specIndex, int n)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isTriggered())
+    {
+        driver->logger.error("wp_set_scans_to_average: triggered acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    return spec->setScansToAverage(n) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_get_scans_to_average(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->getScansToAverage();
+}
+
+int wp_start_continuous(int specIndex, int depth)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->startContinuous(depth) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_start_triggered(int specIndex, int depth)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->startContinuous(depth, true) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_stop_continuous(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->stopContinuous() ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_read_next_spectrum(int specIndex, double* spectrum, int len, int timeoutMS)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spectrum == nullptr)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    return spec->readNextSpectrum(spectrum, len, timeoutMS);
+}
+
+int wp_read_next_spectrum_timestamped(int specIndex, double* spectrum, int len, int timeoutMS, long long* timestampUS)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spectrum == nullptr || timestampUS == nullptr)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    return spec->readNextSpectrum(spectrum, len, timeoutMS, timestampUS);
+}
+
+int wp_register_spectrum_callback(int specIndex, WPSpectrumCallback callback, void* userData)
+{
+    // ring depth when registration starts acquisition
+    const int CALLBACK_DEPTH = 8;
+
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (callback == nullptr)
+        return spec->setSpectrumCallback(Spectrometer::SpectrumCallback(), 0) ? WP_SUCCESS : WP_ERROR;
+
+    // describe each frame in place (the spectrum itself is never copied)
+    auto deliver = [spec, specIndex, callback, userData](const SpectrumRing::Frame& frame)
+    {
+        WPFrame wpFrame;
+        wpFrame.spectrum = frame.spectrum.data();
+        wpFrame.len = (int)frame.spectrum.size();
+        wpFrame.sequence = frame.sequence;
+        wpFrame.timestampUS = frame.timestampUS;
+        wpFrame.overruns = spec->getContinuousOverruns();
+        callback(specIndex, &wpFrame, userData);
+    };
+
+    return spec->setSpectrumCallback(deliver, CALLBACK_DEPTH) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_get_continuous_overruns(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return (int)spec->getContinuousOverruns();
+}
+
 int wp_write_eeprom_page(int specIndex, int pageIndex, unsigned char* data, int dataLen)
 {
     auto spec = driver->getSpectrometer(specIndex);
@@ -759,12 +1103,74 @@ int wp_read_control_msg(int specIndex, unsigned char bRequest, unsigned int wInd
     return (int)response.size();
 }
 
+int wp_set_latency_stats_enable(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->latency.setEnabled(flag != 0);
+    return WP_SUCCESS;
+}
+
+int wp_get_latency_stats(int specIndex, WPLatencyStats* stats, int maxStats)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (stats == nullptr || maxStats < 0)
+        return WP_ERROR;
+
+    auto summaries = spec->latency.summarize();
+    int count = min(maxStats, (int)summaries.size());
+    for (int i = 0; i < count; i++)
+    {
+        const auto& s = summaries[i];
+        stats[i].key = s.key;
+        stats[i].count = s.count;
+        stats[i].meanUS = s.meanUS;
+        stats[i].p50US = s.p50US;
+        stats[i].p99US = s.p99US;
+        stats[i].maxUS = s.maxUS;
+    }
+    return count;
+}
+
+int wp_reset_latency_stats(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->latency.reset();
+    return WP_SUCCESS;
+}
+
+int wp_get_usb_stats(int specIndex, WPUsbStats* device, WPUsbStats* bus)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (device != nullptr)
+        exportUsbStats(spec->getUsbStats(), spec->bus, device);
+
+    if (bus != nullptr)
+    {
+        UsbStats stats;
+        driver->getBusUsbStats(spec->bus, stats);
+        exportUsbStats(stats, spec->bus, bus);
+    }
+    return WP_SUCCESS;
+}
+
 int wp_get_cropped_spectrum_length(int specIndex) 
 {
     auto spec = driver->getSpectrometer(specIndex);
         if (spec == nullptr)
             return WP_ERROR_INVALID_SPECTROMETER;
-    auto eeprom = spec->eeprom;
+    const auto& eeprom = spec->eeprom;
 
     return eeprom.ROIHorizEnd - eeprom.ROIHorizStart + 1;
 }
@@ -775,23 +1181,13 @@ int wp_get_raman_intensity_factors(int specIndex, double* factors, int factorsLe
     if (spec == nullptr)
         return WP_ERROR_INVALID_SPECTROMETER;
 
-    auto eeprom = spec->eeprom;
-    if (eeprom.intensityCorrectionCoeffs.empty())
+    if (spec->eeprom.intensityCorrectionCoeffs.empty())
         return WP_ERROR_NO_CALIBRATION;
     
-    // expanding coeffs and calculating factors
+    // factors are cached per-pixel when the EEPROM is read
+    int start = spec->eeprom.ROIHorizStart;
     for (int i = 0; i < factorsLen; i++)
-    {
-        int px = eeprom.ROIHorizStart + i;
-        double logTen = 0.0;
-        for (int j = 0; j < eeprom.intensityCorrectionCoeffs.size(); j++)
-        {
-            double x_to_i = pow(px, j);
-            double scaled = eeprom.intensityCorrectionCoeffs[j] * x_to_i;
-            logTen += scaled;
-        }
-        factors[i] = pow(10, logTen);
-    }
+        factors[i] = spec->getRamanIntensityFactor(start + i);
     return WP_SUCCESS;
 }
 
@@ -810,6 +1206,372 @@ int wp_apply_raman_intensity_factors(int specIndex, double* spectrum, int spectr
     return WP_SUCCESS;
 }
 
+int wp_set_raman_intensity_correction_enable(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (flag && spec->ramanIntensityFactors.empty())
+        return WP_ERROR_NO_CALIBRATION;
+
+    return spec->pipeline.setRamanIntensityCorrection(flag != 0) ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_get_raman_intensity_correction_enable(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->pipeline.getRamanIntensityCorrection() ? 1 : 0;
+}
+
+int wp_set_processing_invert_x(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->pipeline.setInvertX(flag != 0);
+    return WP_SUCCESS;
+}
+
+int wp_set_processing_bad_pixel_correction(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->pipeline.setBadPixelCorrection(flag != 0);
+    return WP_SUCCESS;
+}
+
+int wp_set_processing_bin_2x2(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->pipeline.setBin2x2(flag != 0);
+    return WP_SUCCESS;
+}
+
+int wp_set_processing_nonlinearity_correction(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return spec->pipeline.setNonlinearityCorrection(flag != 0) ? WP_SUCCESS : WP_ERROR_NO_CALIBRATION;
+}
+
+int wp_set_processing_baseline_removal(int specIndex, int method, double lambda, double p, int maxIterations)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (method < WP_BASELINE_NONE || method > WP_BASELINE_AIRPLS)
+    {
+        driver->logger.error("wp_set_processing_baseline_removal: invalid method %d", method);
+        return WP_ERROR;
+    }
+
+    if (!spec->pipeline.setBaselineRemoval((BaselineRemover::Method)method, lambda, p, maxIterations))
+    {
+        driver->logger.error("wp_set_processing_baseline_removal: invalid parameters");
+        return WP_ERROR;
+    }
+    return WP_SUCCESS;
+}
+
+int wp_set_processing_savitzky_golay(int specIndex, int halfWidth, int order, int derivative)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (!spec->pipeline.setSavitzkyGolay(halfWidth, order, derivative))
+    {
+        driver->logger.error("wp_set_processing_savitzky_golay: invalid parameters");
+        return WP_ERROR;
+    }
+    return WP_SUCCESS;
+}
+
+int wp_savitzky_golay(const double* spectrum, double* output, int len, int halfWidth, int order, int derivative)
+{
+    if (spectrum == nullptr || output == nullptr)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    SavitzkyGolay filter;
+    if (halfWidth < 1 || len < 2 * halfWidth + 1 || !filter.configure(halfWidth, order, derivative))
+        return WP_ERROR;
+
+    if (output != spectrum)
+        memcpy(output, spectrum, len * sizeof(double));
+    filter.apply(output, len);
+    return WP_SUCCESS;
+}
+
+int wp_store_dark(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isContinuous())
+    {
+        driver->logger.error("wp_store_dark: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    return spec->storeDark() ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_clear_dark(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->pipeline.clearDark();
+    return WP_SUCCESS;
+}
+
+int wp_store_reference(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isContinuous())
+    {
+        driver->logger.error("wp_store_reference: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    return spec->storeReference() ? WP_SUCCESS : WP_ERROR;
+}
+
+int wp_clear_reference(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->pipeline.clearReference();
+    return WP_SUCCESS;
+}
+
+int wp_set_processing_mode(int specIndex, int mode)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (mode < WP_PROCESSING_MODE_SCOPE || mode > WP_PROCESSING_MODE_ABSORBANCE)
+    {
+        driver->logger.error("wp_set_processing_mode: invalid mode %d", mode);
+        return WP_ERROR;
+    }
+
+    return spec->pipeline.setMode((ProcessingPipeline::Mode)mode) ? WP_SUCCESS : WP_ERROR_NO_CALIBRATION;
+}
+
+int wp_get_processing_mode(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return (int)spec->pipeline.getMode();
+}
+
+int wp_set_output_axis(int specIndex, double start, double step, int count, int units)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (units != WP_AXIS_WAVELENGTH_NM && units != WP_AXIS_WAVENUMBER_CM)
+        return WP_ERROR;
+
+    return spec->setOutputAxis(start, step, count, units == WP_AXIS_WAVENUMBER_CM);
+}
+
+int wp_set_processing_profiling(int specIndex, int flag)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->pipeline.setProfiling(flag != 0);
+    return WP_SUCCESS;
+}
+
+int wp_get_processing_stage_count(int specIndex)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return ProcessingPipeline::STAGE_COUNT;
+}
+
+int wp_get_processing_stage_name(int specIndex, int index, char* value, int len)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    const char* name = ProcessingPipeline::getStageName(index);
+    if (name == nullptr)
+        return WP_ERROR; // invalid index
+
+    return exportString(name, value, len);
+}
+
+float wp_get_processing_stage_time_us(int specIndex, int index)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    return (float)spec->pipeline.getStageTimeUS(index);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Peakfinding
+////////////////////////////////////////////////////////////////////////////////
+
+static PeakFinder::Params toPeakParams(const WPPeakParams* params)
+{
+    PeakFinder::Params p;
+    if (params != nullptr)
+    {
+        p.minHeight = params->minHeight;
+        p.minProminence = params->minProminence;
+        p.minWidth = params->minWidth;
+        p.maxWidth = params->maxWidth;
+        p.minDistance = params->minDistance;
+    }
+    return p;
+}
+
+static int exportPeaks(const vector<PeakFinder::Peak>& found, WPPeak* peaks, int maxPeaks)
+{
+    int count = min((int)found.size(), maxPeaks);
+    for (int i = 0; i < count; i++)
+    {
+        peaks[i].pixel      = found[i].pixel;
+        peaks[i].wavelength = found[i].wavelength;
+        peaks[i].wavenumber = found[i].wavenumber;
+        peaks[i].intensity  = found[i].intensity;
+        peaks[i].prominence = found[i].prominence;
+        peaks[i].width      = found[i].width;
+    }
+    return count;
+}
+
+int wp_find_peaks(int specIndex, const double* spectrum, int len, const WPPeakParams* params, WPPeak* peaks, int maxPeaks)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spectrum == nullptr || peaks == nullptr || maxPeaks < 1)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    vector<PeakFinder::Peak> found;
+    if (spec->findPeaks(spectrum, len, toPeakParams(params), maxPeaks, found) < 0)
+        return WP_ERROR;
+
+    return exportPeaks(found, peaks, maxPeaks);
+}
+
+int wp_get_spectrum_peaks(int specIndex, const WPPeakParams* params, WPPeak* peaks, int maxPeaks)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spec->isContinuous())
+    {
+        driver->logger.error("wp_get_spectrum_peaks: continuous acquisition is running");
+        return WP_ERROR_BUSY;
+    }
+
+    if (peaks == nullptr || maxPeaks < 1)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    vector<PeakFinder::Peak> found;
+    if (spec->getSpectrumPeaks(toPeakParams(params), maxPeaks, found) < 0)
+    {
+        driver->logger.error("wp_get_spectrum_peaks: error generating spectrum");
+        return WP_ERROR;
+    }
+
+    delay();
+    return exportPeaks(found, peaks, maxPeaks);
+}
+
+int wp_fit_peaks(int specIndex, const double* spectrum, int len, int shape, const WPPeak* guesses, WPPeakFit* fits, int count)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    if (spectrum == nullptr || guesses == nullptr || fits == nullptr || count < 1)
+        return WP_ERROR_INSUFFICIENT_STORAGE;
+
+    if (shape < WP_PEAK_SHAPE_GAUSSIAN || shape > WP_PEAK_SHAPE_PSEUDO_VOIGT)
+    {
+        driver->logger.error("wp_fit_peaks: invalid shape %d", shape);
+        return WP_ERROR;
+    }
+
+    vector<PeakFitter::Guess> initial(count);
+    for (int i = 0; i < count; i++)
+    {
+        initial[i].pixel = guesses[i].pixel;
+        initial[i].fwhm = guesses[i].width;
+        initial[i].amplitude = guesses[i].prominence;
+    }
+
+    vector<PeakFitter::Fit> fitted;
+    int converged = spec->fitPeaks(spectrum, len, (PeakFitter::Shape)shape, initial, fitted);
+    if (converged < 0)
+        return WP_ERROR;
+
+    for (int i = 0; i < count; i++)
+    {
+        fits[i].pixel      = fitted[i].pixel;
+        fits[i].wavelength = fitted[i].wavelength;
+        fits[i].wavenumber = fitted[i].wavenumber;
+        fits[i].fwhm       = fitted[i].fwhm;
+        fits[i].amplitude  = fitted[i].amplitude;
+        fits[i].area       = fitted[i].area;
+        fits[i].baseline   = fitted[i].baseline;
+        fits[i].eta        = fitted[i].eta;
+        fits[i].rms        = fitted[i].rms;
+        fits[i].iterations = fitted[i].iterations;
+        fits[i].converged  = fitted[i].converged ? 1 : 0;
+    }
+    return converged;
+}
+
+int wp_set_peak_fit_threads(int specIndex, int threads)
+{
+    auto spec = driver->getSpectrometer(specIndex);
+    if (spec == nullptr)
+        return WP_ERROR_INVALID_SPECTROMETER;
+
+    spec->peakFitter.setThreads(threads);
+    return WP_SUCCESS;
+}
+
 int wp_has_srm_calibration(int specIndex)
 {
     auto spec = driver->getSpectrometer(specIndex);
@@ -323,10 +323,126 @@ class WasatchVCPP
 
     const string DLL = "WasatchVCPP.dll";
     public const int WP_SUCCESS = 0;
-
+    public const int WP_ERROR_TIMEOUT = -7;
+    public const int WP_ERROR_BUSY = -8;
+    public const int WP_AXIS_WAVELENGTH_NM = 0;
+    public const int WP_AXIS_WAVENUMBER_CM = 1;
+    public const int WP_PEAK_SHAPE_GAUSSIAN = 0;
+    public const int WP_PEAK_SHAPE_LORENTZIAN = 1;
+    public const int WP_PEAK_SHAPE_PSEUDO_VOIGT = 2;
+    public const int WP_BASELINE_NONE = 0;
+    public const int WP_BASELINE_ALS = 1;
+    public const int WP_BASELINE_AIRPLS = 2;
+    public const int WP_PROCESSING_MODE_SCOPE = 0;
+    public const int WP_PROCESSING_MODE_TRANSMISSION = 1;
+    public const int WP_PROCESSING_MODE_REFLECTANCE = 2;
+    public const int WP_PROCESSING_MODE_ABSORBANCE = 3;
+    public const int WP_LATENCY_SECOND_TIER = 0x100;
+    public const int WP_LATENCY_BULK = 0x200;
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPPeakParams
+    {
+        public double minHeight;
+        public double minProminence;
+        public double minWidth;
+        public double maxWidth;
+        public int minDistance;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPPeak
+    {
+        public double pixel;
+        public double wavelength;
+        public double wavenumber;
+        public double intensity;
+        public double prominence;
+        public double width;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPPeakFit
+    {
+        public double pixel;
+        public double wavelength;
+        public double wavenumber;
+        public double fwhm;
+        public double amplitude;
+        public double area;
+        public double baseline;
+        public double eta;
+        public double rms;
+        public int iterations;
+        public int converged;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPFrame
+    {
+        public IntPtr spectrum; // read-only, valid only during the callback
+        public int len;
+        public ulong sequence;
+        public long timestampUS;
+        public ulong overruns;
+    }
+
+    //! keep a reference to the delegate for as long as it is registered
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate void WPSpectrumCallback(int specIndex, ref WPFrame frame, IntPtr userData);
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPSpectrumMetadata
+    {
+        public long triggerTimestampUS;
+        public long receiveTimestampUS;
+        public ulong sequence;
+        public ulong drops;
+        public int integrationTimeMS;
+        public int scansAveraged;
+        public float detectorGain;
+        public int detectorOffset;
+        public int laserEnabled;
+        public float laserPowerPerc;
+        public float detectorTemperatureDegC;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPLatencyStats
+    {
+        public int key;
+        public ulong count;
+        public double meanUS;
+        public double p50US;
+        public double p99US;
+        public double maxUS;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct WPUsbStats
+    {
+        public int bus;
+        public ulong bulkBytesRead;
+        public ulong bulkTransfers;
+        public ulong bulkTimeouts;
+        public ulong bulkRetries;
+        public ulong bulkOddReads;
+        public ulong bulkFailures;
+        public ulong cancellations;
+        public ulong controlTransfers;
+        public ulong controlFailures;
+    }
+
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_acquire_all(IntPtr[] spectra, int[] lens, long[] triggerTimestampsUS, int count);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_clear_dark(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_clear_reference(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_close_all_spectrometers();
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_close_spectrometer(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern void               wp_destroy_driver();
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_find_peaks(int specIndex, ref double spectrum, int len, ref WPPeakParams peakParams, ref WPPeak peaks, int maxPeaks);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_fit_peaks(int specIndex, ref double spectrum, int len, int shape, ref WPPeak guesses, ref WPPeakFit fits, int count);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_async_bulk_transfers(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_continuous_overruns(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern float /* tested */ wp_get_detector_gain(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern float /* tested */ wp_get_detector_gain_odd(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_detector_tec_setpoint_deg_c(int specIndex);
@@ -344,22 +460,43 @@ class WasatchVCPP
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_high_gain_mode_enable(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_integration_time_ms(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_laser_enable(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_latency_stats(int specIndex, ref WPLatencyStats stats, int maxStats);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_library_version(ref byte value, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_max_timeout_ms(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_model(int specIndex, ref byte value, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_number_of_spectrometers();
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_pixels(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_processing_mode(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_processing_stage_count(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_processing_stage_name(int specIndex, int index, ref byte value, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern float              wp_get_processing_stage_time_us(int specIndex, int index);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_raman_intensity_correction_enable(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_scans_to_average(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_serial_number(int specIndex, ref byte value, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_spectrum(int specIndex, ref double spectrum, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_spectrum_ex(int specIndex, ref double spectrum, int len, ref WPSpectrumMetadata metadata);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_spectrum_float(int specIndex, ref float spectrum, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_spectrum_length(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_spectrum_peaks(int specIndex, ref WPPeakParams peakParams, ref WPPeak peaks, int maxPeaks);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_spectrum_raw_u16(int specIndex, ref ushort spectrum, int len, int postProcess);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_usb_stats(int specIndex, ref WPUsbStats device, ref WPUsbStats bus);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_wavelengths(int specIndex, ref double wavelengths, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_wavelengths_float(int specIndex, ref float wavelengths, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_get_wavenumbers(int specIndex, ref double wavenumbers, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_get_wavenumbers_float(int specIndex, ref float wavenumbers, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_log_debug(ref byte msg, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_open_all_spectrometers();
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_open_replay(ref byte pathname, int len, int realTime);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_read_control_msg(byte bRequest, ushort wIndex, ref byte data, int len, int fullLen);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_read_next_spectrum(int specIndex, ref double spectrum, int len, int timeoutMS);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_read_next_spectrum_timestamped(int specIndex, ref double spectrum, int len, int timeoutMS, ref long timestampUS);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_read_spectrum(int specIndex, ref double spectrum, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_register_spectrum_callback(int specIndex, WPSpectrumCallback callback, IntPtr userData);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_reset_latency_stats(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_savitzky_golay(ref double spectrum, ref double output, int len, int halfWidth, int order, int derivative);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_send_control_msg(byte bRequest, ushort wValue, ushort wIndex, ref byte data, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_send_software_trigger(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_async_bulk_transfers(int specIndex, int count);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_detector_gain(int specIndex, float value);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_detector_gain_odd(int specIndex, float value);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_detector_offset(int specIndex, int value);
@@ -369,9 +506,30 @@ class WasatchVCPP
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_high_gain_mode_enable(int specIndex, int value);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_integration_time_ms(int specIndex, uint ms);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_laser_enable(int specIndex, int value); 
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_latency_stats_enable(int specIndex, int flag);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_log_level(int level);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_logfile_path(ref byte pathname, int len);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_cancel_operation(int specIndex);
     [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int   /* tested */ wp_set_max_timeout_ms(int specIndex, int maxTimeoutMS);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_output_axis(int specIndex, double start, double step, int count, int units);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_peak_fit_threads(int specIndex, int threads);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_bad_pixel_correction(int specIndex, int flag);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_baseline_removal(int specIndex, int method, double lambda, double p, int maxIterations);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_bin_2x2(int specIndex, int flag);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_invert_x(int specIndex, int flag);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_mode(int specIndex, int mode);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_nonlinearity_correction(int specIndex, int flag);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_profiling(int specIndex, int flag);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_processing_savitzky_golay(int specIndex, int halfWidth, int order, int derivative);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_raman_intensity_correction_enable(int specIndex, int flag);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_scans_to_average(int specIndex, int n);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_simulated_eeprom(ref byte image, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_simulated_spectrometers(int count, int pixels, float latencyScale);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_set_usb_capture(ref byte prefix, int len);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_start_continuous(int specIndex, int depth);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_start_triggered(int specIndex, int depth);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_stop_continuous(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_store_dark(int specIndex);
+    [DllImport(DLL, CallingConvention = CallingConvention.Cdecl)] public static extern int                wp_store_reference(int specIndex);
 }
 
@@ -0,0 +1,254 @@
+/**
+    @file   bench-badpixels.cpp
+    @brief  micro-benchmark of bad-pixel correction
+
+    Marks random pixels bad in a synthetic EEPROM, compiles them into
+    interpolation runs (EEPROM::compileBadPixelRuns) and times the library's
+    correction per frame against the previous algorithm, which walked the
+    sorted bad-pixel list and searched std::set for each run's good
+    neighbours (reproduced here as a reference).  Both are checked to give
+    identical spectra.  No spectrometer is required.
+
+    Raw (uint16) spectra receive bad-pixel correction alone, so that figure
+    is the correction itself (plus ProcessingPipeline's lock).  For processed
+    (double) spectra correction is normally folded into the pipeline's fused
+    pass, so it is instead timed by the pipeline's own profiler, which runs
+    each stage as a separate pass and times just that pass (including 
+    reading the clock, whose cost is also shown).  Times are the fastest of
+    several rounds.
+
+    usage: bench-badpixels [--bad n] [--count n]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "../WasatchVCPPLib/WasatchVCPPLib/EEPROM.h"
+#include "../WasatchVCPPLib/WasatchVCPPLib/Logger.h"
+#include "../WasatchVCPPLib/WasatchVCPPLib/ProcessingPipeline.h"
+
+using std::vector;
+using WasatchVCPP::EEPROM;
+using WasatchVCPP::Logger;
+using WasatchVCPP::ProcessingPipeline;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+int bad = 15;
+int count = 20000;
+int rounds = 5;
+
+////////////////////////////////////////////////////////////////////////////////
+// reference: correction as applied before bad pixels were compiled into runs
+////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void legacyInterpolate(T* spectrum, int prevGood, int nextGood)
+{
+    float deltaIntensity = spectrum[nextGood] - spectrum[prevGood];
+    int rangePix = nextGood - prevGood;
+    float intensityPerPix = deltaIntensity / rangePix;
+    for (int j = 0; j < rangePix - 1; j++)
+        spectrum[prevGood + j + 1] = spectrum[prevGood] + intensityPerPix * (j + 1);
+}
+
+void legacyInterpolate(uint16_t* spectrum, int prevGood, int nextGood)
+{
+    int deltaIntensity = spectrum[nextGood] - spectrum[prevGood];
+    int rangePix = nextGood - prevGood;
+    for (int j = 0; j < rangePix - 1; j++)
+    {
+        int step = deltaIntensity * (j + 1);
+        step = step >= 0 ? (step + rangePix / 2) / rangePix : -((-step + rangePix / 2) / rangePix);
+        spectrum[prevGood + j + 1] = (uint16_t)(spectrum[prevGood] + step);
+    }
+}
+
+template<typename T>
+void legacyCorrect(const EEPROM& eeprom, T* spectrum, int pixels)
+{
+    for (int i = 0; i < (int)eeprom.badPixelsVector.size(); i++)
+    {
+        auto badPix = eeprom.badPixelsVector[i];
+
+        if (badPix < 0)
+            continue;
+
+        if (badPix == 0)
+        {
+            // handle left edge
+            auto nextGood = badPix + 1;
+            while (eeprom.badPixelsSet.count(nextGood) && nextGood < pixels)
+            {
+                nextGood++;
+                i++;
+            }
+            if (nextGood < pixels)
+                for (int j = 0; j < nextGood; j++)
+                    spectrum[j] = spectrum[nextGood];
+        }
+        else
+        {
+            // find previous good pixel
+            auto prevGood = badPix - 1;
+            while (eeprom.badPixelsSet.count(prevGood) && prevGood >= 0)
+                prevGood -= 1;
+
+            if (prevGood >= 0)
+            {
+                // find next good pixel
+                auto nextGood = badPix + 1;
+                while (eeprom.badPixelsSet.count(nextGood) && nextGood < pixels)
+                {
+                    nextGood++;
+                    i++;
+                }
+
+                if (nextGood < pixels)
+                    legacyInterpolate(spectrum, prevGood, nextGood);
+                else
+                {
+                    // we ran off the high end, so copy-right
+                    for (int j = badPix; j < pixels; j++)
+                        spectrum[j] = spectrum[prevGood];
+                }
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+//! @returns mean nanoseconds per call of fn over 'count' calls, taking the
+//!          fastest of several rounds to suppress scheduling noise
+double timeNS(const std::function<void()>& fn)
+{
+    for (int i = 0; i < 100; i++)
+        fn(); // warm-up
+
+    double best = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        auto start = Clock::now();
+        for (int i = 0; i < count; i++)
+            fn();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+        if (round == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+//! @returns the profiler's mean nanoseconds per frame spent correcting bad 
+//!          pixels in processed spectra, over 'count' frames (fastest of 
+//!          several rounds)
+double stageNS(ProcessingPipeline& pipeline, double* spectrum)
+{
+    pipeline.setProfiling(true);
+    for (int i = 0; i < 100; i++)
+        pipeline.process(spectrum); // warm-up
+
+    double best = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        pipeline.resetTiming();
+        for (int i = 0; i < count; i++)
+            pipeline.process(spectrum);
+        double ns = 1000 * pipeline.getStageTimeUS(ProcessingPipeline::STAGE_BAD_PIXELS);
+        if (round == 0 || ns < best)
+            best = ns;
+    }
+    pipeline.setProfiling(false);
+    return best;
+}
+
+//! @returns nanoseconds taken to time an empty stage, as the profiler would
+double clockNS()
+{
+    typedef std::chrono::steady_clock Profiler;
+    volatile double sink = 0;
+    return timeNS([&]() {
+        auto start = Profiler::now();
+        sink = sink + std::chrono::duration<double, std::micro>(Profiler::now() - start).count();
+    });
+}
+
+bool run(int pixels)
+{
+    std::mt19937 rng(pixels);
+
+    Logger logger;
+    logger.level = Logger::Levels::LOG_LEVEL_NEVER;
+    EEPROM eeprom(logger);
+    eeprom.activePixelsHoriz = (uint16_t)pixels;
+
+    std::uniform_int_distribution<int> position(0, pixels - 1);
+    while ((int)eeprom.badPixelsSet.size() < std::min(bad, pixels - 1))
+        eeprom.badPixelsSet.insert((int16_t)position(rng));
+    eeprom.badPixelsVector.assign(eeprom.badPixelsSet.begin(), eeprom.badPixelsSet.end());
+    eeprom.compileBadPixelRuns(pixels);
+
+    ProcessingPipeline pipeline;
+    pipeline.init(eeprom, vector<double>());
+
+    // synthetic spectrum: sloped baseline plus noise
+    std::normal_distribution<double> noise(0, 50);
+    vector<uint16_t> raw(pixels);
+    for (int i = 0; i < pixels; i++)
+        raw[i] = (uint16_t)std::max(0.0, std::min(65535.0, 800 + 20.0 * i + noise(rng)));
+    vector<double> cooked(raw.begin(), raw.end());
+
+    // check that both algorithms give the same spectra
+    vector<uint16_t> rawLegacy(raw), rawRuns(raw);
+    vector<double> cookedLegacy(cooked), cookedRuns(cooked);
+    legacyCorrect(eeprom, rawLegacy.data(), pixels);
+    pipeline.process(rawRuns.data());
+    legacyCorrect(eeprom, cookedLegacy.data(), pixels);
+    pipeline.process(cookedRuns.data());
+    bool identical = rawLegacy == rawRuns
+                  && !memcmp(cookedLegacy.data(), cookedRuns.data(), pixels * sizeof(double));
+
+    // correcting a corrected spectrum is idempotent, so time in-place
+    double legacyRaw = timeNS([&]() { legacyCorrect(eeprom, rawLegacy.data(), pixels); });
+    double runsRaw   = timeNS([&]() { pipeline.process(rawRuns.data()); });
+
+    double legacyCooked = timeNS([&]() { legacyCorrect(eeprom, cookedLegacy.data(), pixels); });
+    double runsCooked   = stageNS(pipeline, cookedRuns.data());
+
+    printf("pixels %4d  bad %3d  runs %3d  %s\n", pixels, (int)eeprom.badPixelsSet.size(),
+        (int)eeprom.badPixelRuns.size(), identical ? "identical" : "MISMATCH");
+    printf("    uint16: legacy %8.1f ns/frame  runs %8.1f ns/frame  (%.1fx)\n",
+        legacyRaw, runsRaw, legacyRaw / runsRaw);
+    printf("    double: legacy %8.1f ns/frame  runs %8.1f ns/frame  (%.1fx, including %.1f ns reading the clock)\n",
+        legacyCooked, runsCooked, legacyCooked / runsCooked, clockNS());
+    return identical;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bad") && i + 1 < argc)
+            bad = std::max(0, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--count") && i + 1 < argc)
+            count = std::max(1, atoi(argv[++i]));
+        else
+        {
+            printf("usage: %s [--bad n] [--count n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bool ok = run(1024);
+    ok &= run(2048);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/**
+    @file   bench-fit.cpp
+    @brief  benchmark of WasatchVCPP::PeakFitter on synthetic spectra
+
+    Generates noisy spectra of pseudo-Voigt bands on a sloped baseline,
+    perturbs each band's true position and width into an initial guess, and
+    times fitting all bands with an increasing number of threads.  No
+    spectrometer is required.
+
+    usage: bench-fit [--peaks n] [--count n] [--threads n] [--shape gaussian|lorentzian|voigt]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "../WasatchVCPPLib/WasatchVCPPLib/PeakFitter.h"
+
+using std::vector;
+using WasatchVCPP::PeakFitter;
+
+int peaks = 40;
+int count = 200;
+int maxThreads = 0;
+PeakFitter::Shape shape = PeakFitter::SHAPE_PSEUDO_VOIGT;
+
+struct Band
+{
+    double center, fwhm, amplitude;
+};
+
+void generate(int pixels, std::mt19937& rng, vector<double>& spectrum, vector<Band>& bands)
+{
+    std::uniform_real_distribution<double> fwhm(2, 8);
+    std::uniform_real_distribution<double> amplitude(200, 5000);
+    std::normal_distribution<double> noise(0, 10);
+
+    // evenly spaced bands, jittered within their slot
+    bands.resize(peaks);
+    double slot = (double)pixels / peaks;
+    std::uniform_real_distribution<double> jitter(-slot / 8, slot / 8);
+    for (int i = 0; i < peaks; i++)
+        bands[i] = { (i + 0.5) * slot + jitter(rng), fwhm(rng), amplitude(rng) };
+
+    spectrum.resize(pixels);
+    for (int x = 0; x < pixels; x++)
+    {
+        double y = 800 + 0.2 * x + noise(rng);
+        for (const auto& b : bands)
+        {
+            double d2 = (x - b.center) * (x - b.center) / (b.fwhm * b.fwhm);
+            y += b.amplitude * (0.5 / (1 + 4 * d2) + 0.5 * exp(-4 * log(2.0) * d2));
+        }
+        spectrum[x] = y;
+    }
+}
+
+void run(int pixels)
+{
+    std::mt19937 rng(pixels);
+    std::normal_distribution<double> offset(0, 0.75);
+
+    vector<double> spectrum;
+    vector<Band> bands;
+    generate(pixels, rng, spectrum, bands);
+
+    vector<PeakFitter::Guess> guesses(peaks);
+    for (int i = 0; i < peaks; i++)
+    {
+        guesses[i].pixel = bands[i].center + offset(rng);
+        guesses[i].fwhm = bands[i].fwhm * 1.2;
+    }
+
+    int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+    int limit = maxThreads > 0 ? maxThreads : hardware;
+
+    PeakFitter fitter;
+    vector<PeakFitter::Fit> fits;
+    for (int threads = 1; threads <= limit; threads *= 2)
+    {
+        fitter.setThreads(threads);
+        fitter.fit(spectrum.data(), pixels, shape, guesses, fits); // warm-up
+
+        int converged = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+            converged = fitter.fit(spectrum.data(), pixels, shape, guesses, fits);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double centerError = 0;
+        for (int i = 0; i < peaks; i++)
+            centerError += fabs(fits[i].pixel - bands[i].center);
+
+        printf("pixels %4d  peaks %3d  threads %2d  %8.3f ms/spectrum  %8.2f us/peak  converged %3d  mean center error %.3f px\n",
+            pixels, peaks, threads, 1000 * elapsed.count() / count, 1e6 * elapsed.count() / count / peaks,
+            converged, centerError / peaks);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--peaks") && i + 1 < argc)
+            peaks = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--count") && i + 1 < argc)
+            count = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            maxThreads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--shape") && i + 1 < argc)
+        {
+            const char* s = argv[++i];
+            if (!strcmp(s, "gaussian"))
+                shape = PeakFitter::SHAPE_GAUSSIAN;
+            else if (!strcmp(s, "lorentzian"))
+                shape = PeakFitter::SHAPE_LORENTZIAN;
+            else
+                shape = PeakFitter::SHAPE_PSEUDO_VOIGT;
+        }
+        else
+        {
+            printf("usage: %s [--peaks n] [--count n] [--threads n] [--shape gaussian|lorentzian|voigt]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    run(1024);
+    run(2048);
+    return 0;
+}
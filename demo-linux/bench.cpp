@@ -0,0 +1,345 @@
+/**
+    @file   bench.cpp
+    @brief  non-interactive acquisition benchmark of the wp_* API, reporting JSON
+
+    Opens real spectrometers, simulated ones (--simulate) or a captured USB
+    session (--replay, see wp_set_usb_capture), then for each pixel count
+    (simulated only) and integration time reads spectra from every device
+    in parallel (one thread each), timing each wp_get_spectrum call.  Setter
+    and getter round-trips, and a call which never reaches USB
+    (wp_get_pixels), are then timed on each device in turn.
+
+    Results go to stdout as one JSON document, so runs can be saved and
+    compared; latencies are in microseconds.
+
+    usage: bench [--simulate n] [--replay file [--fast]] [--devices n]
+                 [--pixels n[,n...]] [--integration-times ms[,ms...]]
+                 [--count n] [--calls n] [--async n] [--latency-scale x]
+                 [--log-level DEBUG|INFO|ERROR|NEVER]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "WasatchVCPP.h"
+
+using std::vector;
+using std::string;
+
+typedef std::chrono::steady_clock Clock;
+
+const int STR_LEN = 33;
+
+////////////////////////////////////////////////////////////////////////////////
+// Globals
+////////////////////////////////////////////////////////////////////////////////
+
+int simulate = 0;
+string replay;
+bool fast = false;
+int maxDevices = 0;
+vector<int> pixelCounts = { 1024 };
+vector<int> integrationTimesMS = { 1, 10, 100 };
+int count = 100;
+int calls = 100;
+int asyncTransfers = 0;
+float latencyScale = 1;
+int logLevel = WP_LOG_LEVEL_NEVER;
+
+////////////////////////////////////////////////////////////////////////////////
+// Utility
+////////////////////////////////////////////////////////////////////////////////
+
+//! latencies of one API call
+struct Samples
+{
+    vector<double> us;
+    int errors = 0;
+};
+
+//! time fn 'n' times, where fn returns false on error
+void measure(int n, Samples& samples, const std::function<bool()>& fn)
+{
+    for (int i = 0; i < n; i++)
+    {
+        auto start = Clock::now();
+        bool ok = fn();
+        std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+        samples.us.push_back(elapsed.count());
+        if (!ok)
+            samples.errors++;
+    }
+}
+
+double percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t i = (size_t)ceil(p * sorted.size());
+    return sorted[std::min(sorted.size() - 1, i > 0 ? i - 1 : 0)];
+}
+
+string toJSON(Samples samples)
+{
+    vector<double>& us = samples.us;
+    std::sort(us.begin(), us.end());
+
+    double sum = 0;
+    for (auto v : us)
+        sum += v;
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "{ \"calls\": %d, \"errors\": %d, \"mean_us\": %.1f, \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f }",
+        (int)us.size(), samples.errors, us.empty() ? 0 : sum / us.size(),
+        percentile(us, 0.50), percentile(us, 0.90), percentile(us, 0.99), us.empty() ? 0 : us.back());
+    return buf;
+}
+
+string quote(const char* s)
+{
+    string retval = "\"";
+    for ( ; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            retval += '\\';
+        if ((unsigned char)*s >= 0x20)
+            retval += *s;
+    }
+    return retval + "\"";
+}
+
+vector<int> parseList(const char* s)
+{
+    vector<int> values;
+    for (const char* p = s; *p; )
+    {
+        values.push_back(atoi(p));
+        p = strchr(p, ',');
+        if (p == nullptr)
+            break;
+        p++;
+    }
+    return values;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+//! @returns the number of devices to benchmark (0 on error)
+int open(int pixels)
+{
+    if (!replay.empty())
+        return wp_open_replay(replay.c_str(), (int)replay.size(), fast ? 0 : 1) >= 0 ? 1 : 0;
+
+    if (simulate > 0)
+        wp_set_simulated_spectrometers(simulate, pixels, latencyScale);
+
+    int devices = wp_open_all_spectrometers();
+    if (devices <= 0)
+        return 0;
+    if (maxDevices > 0)
+        devices = std::min(devices, maxDevices);
+
+    // simulated and replayed devices only support blocking reads, so report
+    // what each device actually uses (see printDevices)
+    for (int i = 0; i < devices; i++)
+        if (asyncTransfers > 0 && WP_SUCCESS != wp_set_async_bulk_transfers(i, asyncTransfers))
+            fprintf(stderr, "device %d: asynchronous bulk transfers not supported\n", i);
+    return devices;
+}
+
+void printDevices(int devices)
+{
+    printf("      \"devices\": [\n");
+    for (int i = 0; i < devices; i++)
+    {
+        char serialNumber[STR_LEN] = { 0 };
+        char model[STR_LEN] = { 0 };
+        wp_get_serial_number(i, serialNumber, sizeof(serialNumber));
+        wp_get_model(i, model, sizeof(model));
+        printf("        { \"index\": %d, \"serial_number\": %s, \"model\": %s, \"pixels\": %d, \"async_transfers\": %d }%s\n",
+            i, quote(serialNumber).c_str(), quote(model).c_str(), wp_get_pixels(i), 
+            wp_get_async_bulk_transfers(i), i + 1 < devices ? "," : "");
+    }
+    printf("      ],\n");
+}
+
+void run(int devices, int integrationTimeMS, bool last)
+{
+    vector<vector<double> > spectra(devices);
+    for (int i = 0; i < devices; i++)
+    {
+        spectra[i].resize(wp_get_pixels(i));
+        wp_set_integration_time_ms(i, integrationTimeMS);
+        wp_get_spectrum(i, spectra[i].data(), (int)spectra[i].size()); // warm-up
+    }
+
+    // acquire from all devices in parallel
+    vector<Samples> acquisitions(devices);
+    vector<std::thread> threads;
+    auto start = Clock::now();
+    for (int i = 0; i < devices; i++)
+        threads.push_back(std::thread([&, i]() {
+            measure(count, acquisitions[i], [&]() {
+                return WP_SUCCESS == wp_get_spectrum(i, spectra[i].data(), (int)spectra[i].size());
+            });
+        }));
+    for (auto& t : threads)
+        t.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    Samples spectrum;
+    for (auto& a : acquisitions)
+    {
+        spectrum.us.insert(spectrum.us.end(), a.us.begin(), a.us.end());
+        spectrum.errors += a.errors;
+    }
+
+    double meanUS = 0;
+    for (auto v : spectrum.us)
+        meanUS += v;
+    meanUS /= spectrum.us.size();
+
+    // round-trips, one device at a time
+    Samples setter, getter, temperature, local;
+    for (int i = 0; i < devices; i++)
+    {
+        measure(calls, setter, [&]() { return WP_SUCCESS == wp_set_integration_time_ms(i, integrationTimeMS); });
+        measure(calls, getter, [&]() { return wp_get_integration_time_ms(i) >= 0; });
+        measure(calls, temperature, [&]() { return wp_get_detector_temperature_deg_c(i) != WP_ERROR_INVALID_TEMPERATURE; });
+        measure(calls, local, [&]() { return wp_get_pixels(i) > 0; });
+    }
+
+    printf("        {\n");
+    printf("          \"integration_time_ms\": %d,\n", integrationTimeMS);
+    printf("          \"spectra\": %d,\n", devices * count);
+    printf("          \"elapsed_sec\": %.3f,\n", elapsed.count());
+    printf("          \"spectra_per_sec\": %.2f,\n", devices * count / elapsed.count());
+    printf("          \"get_spectrum_overhead_us\": %.1f,\n", meanUS - 1000.0 * integrationTimeMS * (simulate > 0 ? latencyScale : 1));
+    printf("          \"wp_get_spectrum\": %s,\n", toJSON(spectrum).c_str());
+    printf("          \"wp_set_integration_time_ms\": %s,\n", toJSON(setter).c_str());
+    printf("          \"wp_get_integration_time_ms\": %s,\n", toJSON(getter).c_str());
+    printf("          \"wp_get_detector_temperature_deg_c\": %s,\n", toJSON(temperature).c_str());
+    printf("          \"wp_get_pixels\": %s\n", toJSON(local).c_str());
+    printf("        }%s\n", last ? "" : ",");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main()
+////////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [--simulate n] [--replay file [--fast]] [--devices n] [--pixels n[,n...]]\n"
+        "       [--integration-times ms[,ms...]] [--count n] [--calls n] [--async n]\n"
+        "       [--latency-scale x] [--log-level DEBUG|INFO|ERROR|NEVER]\n", name);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--simulate") && i + 1 < argc)
+            simulate = std::max(0, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay = argv[++i];
+        else if (!strcmp(argv[i], "--fast"))
+            fast = true;
+        else if (!strcmp(argv[i], "--devices") && i + 1 < argc)
+            maxDevices = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--pixels") && i + 1 < argc)
+            pixelCounts = parseList(argv[++i]);
+        else if (!strcmp(argv[i], "--integration-times") && i + 1 < argc)
+            integrationTimesMS = parseList(argv[++i]);
+        else if (!strcmp(argv[i], "--count") && i + 1 < argc)
+            count = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--calls") && i + 1 < argc)
+            calls = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--async") && i + 1 < argc)
+            asyncTransfers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--latency-scale") && i + 1 < argc)
+            latencyScale = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--log-level") && i + 1 < argc)
+        {
+            const char* level = argv[++i];
+            if      (!strcmp(level, "DEBUG")) logLevel = WP_LOG_LEVEL_DEBUG;
+            else if (!strcmp(level, "INFO" )) logLevel = WP_LOG_LEVEL_INFO;
+            else if (!strcmp(level, "ERROR")) logLevel = WP_LOG_LEVEL_ERROR;
+            else                              logLevel = WP_LOG_LEVEL_NEVER;
+        }
+        else
+            usage(argv[0]);
+    }
+    if (pixelCounts.empty() || integrationTimesMS.empty())
+        usage(argv[0]);
+
+    // pixel counts only apply to simulated spectrometers
+    if (simulate == 0)
+        pixelCounts.resize(1);
+
+    wp_set_log_level(logLevel);
+    if (logLevel != WP_LOG_LEVEL_NEVER)
+        wp_set_logfile_path("bench.log", 9);
+
+    char version[STR_LEN] = { 0 };
+    wp_get_library_version(version, sizeof(version));
+
+    char timestamp[32] = { 0 };
+    std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%FT%T", std::localtime(&now));
+
+    const char* source = !replay.empty() ? "replay" : simulate > 0 ? "simulated" : "hardware";
+
+    printf("{\n");
+    printf("  \"library_version\": %s,\n", quote(version).c_str());
+    printf("  \"timestamp\": %s,\n", quote(timestamp).c_str());
+    printf("  \"source\": %s,\n", quote(source).c_str());
+    printf("  \"count\": %d,\n", count);
+    printf("  \"calls\": %d,\n", calls);
+    printf("  \"async_transfers\": %d,\n", asyncTransfers);
+    if (simulate > 0)
+        printf("  \"latency_scale\": %.3f,\n", latencyScale);
+    printf("  \"configurations\": [\n");
+
+    int status = 0;
+    for (size_t p = 0; p < pixelCounts.size(); p++)
+    {
+        int devices = open(pixelCounts[p]);
+        if (devices == 0)
+        {
+            fprintf(stderr, "no spectrometers found\n");
+            status = 1;
+            break;
+        }
+
+        printf("%s    {\n", p > 0 ? ",\n" : "");
+        printDevices(devices);
+        printf("      \"runs\": [\n");
+        for (size_t t = 0; t < integrationTimesMS.size(); t++)
+            run(devices, integrationTimesMS[t], t + 1 == integrationTimesMS.size());
+        printf("      ]\n");
+        printf("    }");
+
+        wp_close_all_spectrometers();
+    }
+
+    printf("\n  ]\n");
+    printf("}\n");
+
+    wp_destroy_driver();
+    return status;
+}
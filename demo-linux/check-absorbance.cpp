@@ -0,0 +1,136 @@
+/**
+    @file   check-absorbance.cpp
+    @brief  verifies absorbance stays finite where the ratio is non-positive
+
+    Feeds ProcessingPipeline a stored dark and reference in which some
+    reference pixels equal (or fall below) the dark, then a sample in which
+    some pixels equal (or fall below) the dark.  Those pixels must report the
+    capped absorbance (6) rather than inf or NaN, every other pixel the exact
+    -log10 of its ratio, and nothing may become non-finite once Savitzky-Golay
+    smoothing and baseline removal (which mix neighbouring pixels) are also
+    enabled.  Both the fused and the profiled (stage-at-a-time) passes are
+    checked, in double and float.  No spectrometer is required.
+
+    usage: check-absorbance
+
+    @returns 0 if all checks passed, else 1
+*/
+
+#include <stdio.h>
+
+#include <cmath>
+#include <vector>
+
+#include "../WasatchVCPPLib/WasatchVCPPLib/EEPROM.h"
+#include "../WasatchVCPPLib/WasatchVCPPLib/Logger.h"
+#include "../WasatchVCPPLib/WasatchVCPPLib/ProcessingPipeline.h"
+
+using std::vector;
+using WasatchVCPP::EEPROM;
+using WasatchVCPP::Logger;
+using WasatchVCPP::BaselineRemover;
+using WasatchVCPP::ProcessingPipeline;
+
+const int PIXELS = 64;
+const double DARK = 100;
+const double MAX_ABSORBANCE = 6;
+
+// pixels whose reference or sample doesn't exceed the dark
+const int REF_AT_DARK = 10;
+const int REF_BELOW_DARK = 20;
+const int SAMPLE_AT_DARK = 30;
+const int SAMPLE_BELOW_DARK = 31;
+
+bool isCapped(int px)
+{
+    return px == REF_AT_DARK || px == REF_BELOW_DARK || px == SAMPLE_AT_DARK || px == SAMPLE_BELOW_DARK;
+}
+
+vector<double> sample()
+{
+    vector<double> spectrum(PIXELS, 550);
+    spectrum[SAMPLE_AT_DARK] = DARK;
+    spectrum[SAMPLE_BELOW_DARK] = DARK - 40;
+    return spectrum;
+}
+
+//! @returns true if every pixel of one processed sample is as expected
+template<typename T>
+bool check(const char* label, ProcessingPipeline& pipeline, bool neighbours)
+{
+    vector<double> input = sample();
+    vector<T> spectrum(input.begin(), input.end());
+    pipeline.process(spectrum.data());
+
+    // (550 - 100) / (1000 - 100)
+    const double expected = -log10(0.5);
+    const double tolerance = sizeof(T) == sizeof(float) ? 1e-6 : 1e-12;
+
+    int failures = 0;
+    for (int px = 0; px < PIXELS; px++)
+    {
+        double value = spectrum[px];
+        bool ok = std::isfinite(value);
+        if (ok && !neighbours)
+            ok = fabs(value - (isCapped(px) ? MAX_ABSORBANCE : expected)) < tolerance;
+        if (!ok && failures++ < 5)
+            printf("    pixel %2d: %g\n", px, value);
+    }
+
+    printf("%-40s %s\n", label, failures ? "FAIL" : "ok");
+    return failures == 0;
+}
+
+template<typename T>
+bool checkAll(ProcessingPipeline& pipeline, const char* type)
+{
+    char label[80];
+    bool ok = true;
+    for (int profiled = 0; profiled < 2; profiled++)
+    {
+        pipeline.setProfiling(profiled != 0);
+        const char* pass = profiled ? "profiled" : "fused";
+
+        pipeline.setSavitzkyGolay(0, 0, 0);
+        pipeline.setBaselineRemoval(BaselineRemover::METHOD_NONE, 0, 0, 0);
+        snprintf(label, sizeof(label), "%s %s", type, pass);
+        ok &= check<T>(label, pipeline, false);
+
+        pipeline.setSavitzkyGolay(3, 2, 0);
+        pipeline.setBaselineRemoval(BaselineRemover::METHOD_ALS, 1e4, 0.01, 10);
+        snprintf(label, sizeof(label), "%s %s, smoothed, baseline", type, pass);
+        ok &= check<T>(label, pipeline, true);
+    }
+    pipeline.setProfiling(false);
+    return ok;
+}
+
+int main()
+{
+    Logger logger;
+    logger.level = Logger::Levels::LOG_LEVEL_NEVER;
+    EEPROM eeprom(logger);
+    eeprom.activePixelsHoriz = PIXELS;
+
+    ProcessingPipeline pipeline;
+    pipeline.init(eeprom, vector<double>());
+
+    vector<double> dark(PIXELS, DARK);
+    vector<double> reference(PIXELS, 1000);
+    reference[REF_AT_DARK] = DARK;
+    reference[REF_BELOW_DARK] = DARK - 50;
+
+    bool ok = pipeline.setDark(dark)
+           && pipeline.setReference(reference)
+           && pipeline.setMode(ProcessingPipeline::MODE_ABSORBANCE);
+    if (!ok)
+        printf("unable to configure absorbance\n");
+    else
+    {
+        ok &= checkAll<double>(pipeline, "double");
+        ok &= checkAll<float>(pipeline, "float");
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
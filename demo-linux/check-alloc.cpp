@@ -0,0 +1,138 @@
+/**
+    @file   check-alloc.cpp
+    @brief  verifies that steady-state acquisition makes no heap allocations
+
+    Replaces the global operator new with a counting one, opens simulated
+    spectrometers (1024 and 2048 pixels, the latter read over two endpoints)
+    and, after a few warm-up spectra, counts allocations made (on any thread)
+    by repeated wp_get_spectrum and wp_get_spectrum_float calls (with and
+    without an output axis), and by continuous acquisition read through
+    wp_read_next_spectrum.  Logging is
+    disabled, as log lines are formatted on the heap.  No spectrometer is
+    required.
+
+    usage: check-alloc [--count n]
+
+    @returns 0 if no allocations were counted, else 1
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "WasatchVCPP.h"
+
+using std::vector;
+
+int count = 100;
+
+std::atomic<bool> counting(false);
+std::atomic<int> allocations(0);
+
+void* operator new(size_t size)
+{
+    if (counting)
+        allocations++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+//! @returns true if fn made no allocations over 'count' calls
+bool check(const char* label, int pixels, const std::function<bool()>& fn)
+{
+    for (int i = 0; i < 3; i++)
+        fn(); // warm-up
+
+    int errors = 0;
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < count; i++)
+        if (!fn())
+            errors++;
+    counting = false;
+
+    printf("pixels %4d  %-28s %3d calls  %3d errors  %5d allocations\n",
+        pixels, label, count, errors, allocations.load());
+    return errors == 0 && allocations == 0;
+}
+
+bool run(int pixels)
+{
+    wp_set_simulated_spectrometers(1, pixels, 0);
+    if (wp_open_all_spectrometers() != 1)
+    {
+        printf("unable to open simulated spectrometer\n");
+        return false;
+    }
+
+    vector<double> spectrum(wp_get_pixels(0));
+    vector<float> spectrumFloat(spectrum.size());
+    const int len = (int)spectrum.size();
+
+    bool ok = true;
+    ok &= check("wp_get_spectrum", pixels, [&]() {
+        return WP_SUCCESS == wp_get_spectrum(0, spectrum.data(), len); });
+    ok &= check("wp_get_spectrum_float", pixels, [&]() {
+        return WP_SUCCESS == wp_get_spectrum_float(0, spectrumFloat.data(), len); });
+
+    if (WP_SUCCESS == wp_start_continuous(0, 8))
+    {
+        ok &= check("wp_read_next_spectrum", pixels, [&]() {
+            return WP_SUCCESS == wp_read_next_spectrum(0, spectrum.data(), len, 1000); });
+        wp_stop_continuous(0);
+    }
+    else
+        ok = false;
+
+    // resampled onto an output axis (half as many points, spanning the detector)
+    vector<double> wavelengths(len);
+    wp_get_wavelengths(0, wavelengths.data(), len);
+    double step = 2 * (wavelengths[len - 1] - wavelengths[0]) / len;
+    if (WP_SUCCESS == wp_set_output_axis(0, wavelengths[0], step, len / 2, WP_AXIS_WAVELENGTH_NM))
+    {
+        ok &= check("wp_get_spectrum (resampled)", pixels, [&]() {
+            return WP_SUCCESS == wp_get_spectrum(0, spectrum.data(), len); });
+        wp_set_output_axis(0, 0, 0, 0, WP_AXIS_WAVELENGTH_NM);
+    }
+    else
+        ok = false;
+
+    wp_close_all_spectrometers();
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--count") && i + 1 < argc)
+            count = std::max(1, atoi(argv[++i]));
+        else
+        {
+            printf("usage: %s [--count n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    wp_set_log_level(WP_LOG_LEVEL_NEVER);
+
+    bool ok = run(1024);
+    ok &= run(2048);
+    wp_destroy_driver();
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -48,6 +48,8 @@ vector<float> wavelengths;
 vector<float> wavenumbers;
 unsigned long delay_us = 0;
 int throwaways = 0;
+int asyncTransfers = 0;
+int continuousDepth = 0;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Utility
@@ -75,6 +77,21 @@ string timestamp()
 // Functional Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
+//! read one spectrum, either on-demand or from the continuous acquisition ring
+bool readSpectrum(float* spectrum)
+{
+    if (continuousDepth <= 0)
+        return WP_SUCCESS == wp_get_spectrum_float(specIndex, spectrum, pixels);
+
+    double values[pixels];
+    if (WP_SUCCESS != wp_read_next_spectrum(specIndex, values, pixels, 2 * integrationTimeMS + 1000))
+        return false;
+
+    for (int i = 0; i < pixels; i++)
+        spectrum[i] = (float)values[i];
+    return true;
+}
+
 void loadWavelengths()
 {
     wavelengths.clear();
@@ -315,6 +332,16 @@ bool init()
         wp_set_integration_time_ms(specIndex, integrationTimeMS);
     }
 
+    if (asyncTransfers > 0)
+    {
+        printf("Reading spectra with %d asynchronous bulk transfers\n", asyncTransfers);
+        if (WP_SUCCESS != wp_set_async_bulk_transfers(specIndex, asyncTransfers))
+        {
+            printf("ERROR: unable to enable asynchronous bulk transfers\n");
+            asyncTransfers = 0;
+        }
+    }
+
     return true;
 }
 
@@ -323,10 +350,17 @@ void demo()
     ////////////////////////////////////////////////////////////////////////////
     // read the requested number of spectra (even for Raman mode, do this to warm-up the sensor)
     ////////////////////////////////////////////////////////////////////////////
+    if (continuousDepth > 0)
+    {
+        printf("Starting continuous acquisition (depth %d)\n", continuousDepth);
+        wp_start_continuous(specIndex, continuousDepth);
+    }
+
+    auto start = std::chrono::steady_clock::now();
     for (int i = 0; i < count; i++)
     {
         float spectrum[pixels];
-        if (WP_SUCCESS == wp_get_spectrum_float(specIndex, spectrum, pixels))
+        if (readSpectrum(spectrum))
         {
             auto now = timestamp();
             printf("%s Spectrum %5d of %5d:", now.c_str(), i + 1, count);
@@ -340,6 +374,19 @@ void demo()
         }
     }
 
+    // report throughput (compare with and without --async)
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (count > 0 && elapsed.count() > 0)
+        printf("read %d spectra in %.3f sec (%.2f spectra/sec, %s reads)\n", 
+            count, elapsed.count(), count / elapsed.count(),
+            asyncTransfers > 0 ? "asynchronous" : "synchronous");
+
+    if (continuousDepth > 0)
+    {
+        wp_stop_continuous(specIndex);
+        printf("stopped continuous acquisition (%d overruns)\n", wp_get_continuous_overruns(specIndex));
+    }
+
     if (ramanModeEnabled)
     {
         performRamanReading();
@@ -380,7 +427,8 @@ void usage()
 {
     printf("Usage: $ demo [--count n] [--integration-time-ms] [--laser] [--raman-mode]\n"
            "              [--log-level DEBUG|INFO|ERROR|NEVER] [--write-eeprom]\n"
-           "              [--delay-us delay_microsec] [--throwaways n]\n");
+           "              [--delay-us delay_microsec] [--throwaways n] [--async n]\n"
+           "              [--continuous depth]\n");
     exit(1);
 }
 
@@ -423,6 +471,20 @@ void parseArgs(int argc, char** argv)
             else
                 usage();
         }
+        else if (!strcmp(argv[i], "--async"))
+        {
+            if (i + 1 < argc) 
+                asyncTransfers = atoi(argv[++i]);
+            else
+                usage();
+        }
+        else if (!strcmp(argv[i], "--continuous"))
+        {
+            if (i + 1 < argc) 
+                continuousDepth = atoi(argv[++i]);
+            else
+                usage();
+        }
         else if (!strcmp(argv[i], "--delay-us"))
         {
             if (i + 1 < argc) 
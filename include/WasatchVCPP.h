@@ -56,6 +56,8 @@
 #define WP_ERROR_NO_LASER              -4     //!< command is only valid on models with a laser and/or defined excitation wavelength
 #define WP_ERROR_NOT_INGAAS            -5     //!< command is only valid on models with an InGaAs detector
 #define WP_ERROR_NO_CALIBRATION        -6     //!< command requires a missing calibration
+#define WP_ERROR_TIMEOUT               -7     //!< no data arrived within the requested timeout
+#define WP_ERROR_BUSY                  -8     //!< command not permitted while continuous acquisition is running
 #define WP_ERROR_INVALID_GAIN          -256   //!< detector gain could not be determined (impossible value)
 #define WP_ERROR_INVALID_TEMPERATURE   -999   //!< temperature could not be measured (impossible value)
 #define WP_ERROR_INVALID_OFFSET        -32768 //!< offset could not be determined (unreasonable value)
@@ -66,6 +68,135 @@
 #define WP_LOG_LEVEL_ERROR              2
 #define WP_LOG_LEVEL_NEVER              3
 
+// methods for wp_set_processing_baseline_removal
+#define WP_BASELINE_NONE                0
+#define WP_BASELINE_ALS                 1     //!< asymmetric least squares
+#define WP_BASELINE_AIRPLS              2     //!< adaptive iteratively reweighted penalized least squares
+
+// modes for wp_set_processing_mode
+#define WP_PROCESSING_MODE_SCOPE        0     //!< intensity (counts)
+#define WP_PROCESSING_MODE_TRANSMISSION 1     //!< percent transmission
+#define WP_PROCESSING_MODE_REFLECTANCE  2     //!< percent reflectance
+#define WP_PROCESSING_MODE_ABSORBANCE   3     //!< absorbance (AU)
+
+// units for wp_set_output_axis
+#define WP_AXIS_WAVELENGTH_NM           0     //!< wavelength in nanometers
+#define WP_AXIS_WAVENUMBER_CM           1     //!< Raman shift in wavenumbers (1/cm)
+
+//! constraints on peaks reported by wp_find_peaks (zero disables each)
+typedef struct
+{
+    double minHeight;       //!< minimum intensity at the apex
+    double minProminence;   //!< minimum height above the surrounding baseline
+    double minWidth;        //!< minimum width in pixels (at half prominence)
+    double maxWidth;        //!< maximum width in pixels (at half prominence)
+    int minDistance;        //!< minimum pixels between peaks (taller peaks win)
+} WPPeakParams;
+
+//! a peak reported by wp_find_peaks
+typedef struct
+{
+    double pixel;           //!< sub-pixel centroid (index into the spectrum)
+    double wavelength;      //!< centroid in nm
+    double wavenumber;      //!< centroid in cm-1 (0 if no excitation)
+    double intensity;       //!< at the apex pixel
+    double prominence;      //!< height above the surrounding baseline
+    double width;           //!< pixels, at half prominence
+} WPPeak;
+
+// line shapes for wp_fit_peaks
+#define WP_PEAK_SHAPE_GAUSSIAN          0
+#define WP_PEAK_SHAPE_LORENTZIAN        1
+#define WP_PEAK_SHAPE_PSEUDO_VOIGT      2     //!< weighted sum of the above, sharing one FWHM
+
+//! a peak fitted by wp_fit_peaks
+typedef struct
+{
+    double pixel;           //!< fitted center (index into the spectrum)
+    double wavelength;      //!< fitted center in nm
+    double wavenumber;      //!< fitted center in cm-1 (0 if no excitation)
+    double fwhm;            //!< full width at half maximum, in pixels
+    double amplitude;       //!< height above baseline
+    double area;            //!< amplitude integrated over pixels
+    double baseline;        //!< fitted (linear) baseline beneath the center
+    double eta;             //!< Lorentzian fraction (0 Gaussian, 1 Lorentzian)
+    double rms;             //!< RMS residual over the fitted window
+    int iterations;         //!< Levenberg-Marquardt iterations
+    int converged;          //!< non-zero if the fit converged
+} WPPeakFit;
+
+//! the circumstances of a spectrum read by wp_get_spectrum_ex
+//!
+//! Timestamps are in microseconds on the same monotonic clock as 
+//! wp_acquire_all's trigger timestamps.  Settings are those the driver last
+//! sent (or read), so cost no extra USB traffic.
+typedef struct
+{
+    long long triggerTimestampUS;   //!< when ACQUIRE was sent (for the first scan, if averaging; 0 if externally triggered)
+    long long receiveTimestampUS;   //!< when the spectrum finished arriving over USB
+    unsigned long long sequence;    //!< acquisitions attempted since the spectrometer was opened, before this one
+    unsigned long long drops;       //!< acquisitions since opened which failed, or were discarded by continuous acquisition
+    int integrationTimeMS;
+    int scansAveraged;              //!< see wp_set_scans_to_average
+    float detectorGain;             //!< as last set (from the EEPROM at startup)
+    int detectorOffset;             //!< as last set (from the EEPROM at startup)
+    int laserEnabled;               //!< non-zero if the laser was last enabled
+    float laserPowerPerc;           //!< as last set by wp_set_laser_power_perc or _mW (0 if never)
+    float detectorTemperatureDegC;  //!< as last read by wp_get_detector_temperature_deg_c (WP_ERROR_INVALID_TEMPERATURE if never)
+} WPSpectrumMetadata;
+
+//! a spectrum delivered to a WPSpectrumCallback
+//!
+//! The frame (including the spectrum it points to) belongs to the library,
+//! and is only valid until the callback returns.
+typedef struct
+{
+    const double* spectrum;         //!< post-processed intensities (read-only)
+    int len;                        //!< points in 'spectrum'
+    unsigned long long sequence;    //!< spectra acquired since starting (gaps indicate overruns)
+    long long timestampUS;          //!< when the host received it (as wp_read_next_spectrum_timestamped)
+    unsigned long long overruns;    //!< spectra dropped since starting (see wp_get_continuous_overruns)
+} WPFrame;
+
+//! @see wp_register_spectrum_callback
+typedef void (*WPSpectrumCallback)(int specIndex, const WPFrame* frame, void* userData);
+
+// offsets of WPLatencyStats.key
+#define WP_LATENCY_SECOND_TIER          0x100 //!< + wValue of a second-tier (bRequest 0xff) opcode
+#define WP_LATENCY_BULK                 0x200 //!< + bulk endpoint (e.g. 0x282 for 0x82)
+
+//! USB latency of one opcode or endpoint, reported by wp_get_latency_stats
+//!
+//! Percentiles are accurate to about 3%.
+typedef struct
+{
+    int key;                        //!< bRequest; WP_LATENCY_SECOND_TIER + wValue; or WP_LATENCY_BULK + endpoint
+    unsigned long long count;       //!< transfers timed since enabled or reset
+    double meanUS;
+    double p50US;
+    double p99US;
+    double maxUS;
+} WPLatencyStats;
+
+//! cumulative USB transfer counts, reported by wp_get_usb_stats
+//!
+//! Bulk counts cover spectral reads.  A "transfer" is one read attempt; a
+//! spectrum may take several (one or more per endpoint), so retries and 
+//! timeouts which nonetheless delivered a spectrum are counted too.
+typedef struct
+{
+    int bus;                                //!< USB bus number (-1 if simulated)
+    unsigned long long bulkBytesRead;
+    unsigned long long bulkTransfers;
+    unsigned long long bulkTimeouts;        //!< transfers which timed out (whether or not retried)
+    unsigned long long bulkRetries;         //!< transfers beyond the first per endpoint per spectrum
+    unsigned long long bulkOddReads;        //!< transfers returning an odd number of bytes
+    unsigned long long bulkFailures;        //!< spectra abandoned on error or timeout
+    unsigned long long cancellations;       //!< spectra abandoned by wp_cancel_operation
+    unsigned long long controlTransfers;
+    unsigned long long controlFailures;     //!< control transfers failing, or returning too few bytes
+} WPUsbStats;
+
 // Although we're using a C++ compiler (as the library is written in C++), we 
 // want these function symbols to be compiled with C linkage (no C++ mangling). 
 // This will ensure that the broadest range of customer languages, compilers and
@@ -156,6 +287,67 @@ extern "C"
     //! wp_open_all_spectrometers can be called again.
     DLL_API void wp_destroy_driver();
 
+    //! Have wp_open_all_spectrometers also open simulated spectrometers 
+    //! (after any real ones), for testing and benchmarking without hardware.
+    //!
+    //! Simulated units answer the standard opcodes from their EEPROM and 
+    //! produce synthetic spectra (a dark baseline and emission lines, plus 
+    //! Raman lines while the laser is "enabled", with noise) on the same 
+    //! acquisition paths as real units.  Their serial numbers are SIM-0000,
+    //! SIM-0001 etc.
+    //!
+    //! @param count (Input) number of simulated spectrometers (0 for none)
+    //! @param pixels (Input) detector width (2048 is read as two endpoints,
+    //!        as real 2048-pixel units are)
+    //! @param latencyScale (Input) fraction of each integration time spent
+    //!        waiting for the spectrum (1 for real time, 0 for no delay)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_simulated_spectrometers(int count, int pixels, float latencyScale);
+
+    //! Give simulated spectrometers an EEPROM image (e.g. one read from a 
+    //! real unit via wp_read_control_msg), rather than the default.
+    //!
+    //! The image's pixel count overrides wp_set_simulated_spectrometers', 
+    //! and every simulated unit shares its serial number.
+    //!
+    //! @param image (Input) consecutive 64-byte EEPROM pages (null to 
+    //!        revert to the default)
+    //! @param len (Input) length of image (a multiple of 64, up to 512)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_simulated_eeprom(const unsigned char* image, int len);
+
+    //! Have wp_open_all_spectrometers capture every USB transfer of each 
+    //! spectrometer it opens (with payloads and relative timestamps) to 
+    //! "<prefix><specIndex>.wpcap", from the spectrometer's first transfer 
+    //! until it is closed, for later use with wp_open_replay.
+    //!
+    //! Spectra are recorded whole, one record per endpoint per acquisition.
+    //!
+    //! @param prefix (Input) path prefix, e.g. "logs/session-" (null or
+    //!        empty to stop capturing)
+    //! @param len (Input) length of prefix
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_usb_capture(const char* prefix, int len);
+
+    //! Opens a spectrometer which replays a session captured by 
+    //! wp_set_usb_capture, so that a recorded workload can be re-run 
+    //! without hardware (e.g. to compare library builds on identical 
+    //! traffic).
+    //!
+    //! Each opcode (and each bulk endpoint) is answered with its recorded 
+    //! responses in order, starting over when they run out; setters not 
+    //! recorded are accepted and getters not recorded fail.  Call after 
+    //! wp_open_all_spectrometers if also using real or simulated units, as 
+    //! it won't open them while any spectrometer is open.
+    //!
+    //! @param pathname (Input) a capture file
+    //! @param len (Input) length of pathname
+    //! @param realTime (Input) non-zero to reproduce each transfer's recorded 
+    //!        duration, zero to answer immediately (measuring only the 
+    //!        library's own overhead)
+    //! @returns the new spectrometer's specIndex, or negative on error
+    DLL_API int wp_open_replay(const char* pathname, int len, int realTime);
+
     ////////////////////////////////////////////////////////////////////////////
     // EEPROM 
     ////////////////////////////////////////////////////////////////////////////
@@ -288,6 +480,327 @@ extern "C"
     //! @returns WP_SUCCESS or non-zero on error
     DLL_API int wp_apply_raman_intensity_factors(int specIndex, double* spectrum, int spectrum_len, double* factors, int factors_len, int start_pixel, int end_pixel);
 
+    //! Apply the NIST SRM Raman Intensity Calibration within the driver, to
+    //! every spectrum subsequently returned by wp_get_spectrum (and its 
+    //! floating-point variants, including continuous acquisition).
+    //!
+    //! The factors are computed once when the spectrometer is opened, and 
+    //! applied over the horizontal ROI exactly as 
+    //! wp_apply_raman_intensity_factors would.  Post-processing stages run in
+    //! this order: bad-pixel correction, 2x2 binning, dark subtraction, Raman
+    //! intensity correction, Savitzky-Golay filtering 
+    //! (wp_set_processing_savitzky_golay), then baseline removal
+    //! (wp_set_processing_baseline_removal).  In the transmission, 
+    //! reflectance and absorbance modes (wp_set_processing_mode) the ratio 
+    //! against the reference takes the place of this correction, which would
+    //! cancel out.  Raw spectra (wp_get_spectrum_raw_u16) are never 
+    //! corrected.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to enable, zero to disable (default)
+    //! @returns WP_SUCCESS, WP_ERROR_NO_CALIBRATION or non-zero on error
+    DLL_API int wp_set_raman_intensity_correction_enable(int specIndex, int flag);
+
+    //! @see wp_set_raman_intensity_correction_enable
+    //! @param specIndex (Input) which spectrometer
+    //! @returns 1 if enabled, 0 if disabled, negative on error
+    DLL_API int wp_get_raman_intensity_correction_enable(int specIndex);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Post-Processing
+    ////////////////////////////////////////////////////////////////////////////
+
+    //! Reverse the order of pixels in each spectrum.
+    //!
+    //! Defaults to the EEPROM's invertXAxis feature flag.  Applied while
+    //! the spectrum is demarshalled, so it costs no additional pass.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to enable, zero to disable
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_processing_invert_x(int specIndex, int flag);
+
+    //! Interpolate over the bad pixels listed in the EEPROM (enabled by default).
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to enable, zero to disable
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_processing_bad_pixel_correction(int specIndex, int flag);
+
+    //! Average each pixel with its right-hand neighbor (for Bayer filters).
+    //!
+    //! Defaults to the EEPROM's bin2x2 feature flag.  Never applied to raw
+    //! spectra.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to enable, zero to disable
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_processing_bin_2x2(int specIndex, int flag);
+
+    //! Correct detector nonlinearity using the EEPROM's linearityCoeffs.
+    //!
+    //! Each raw count x is replaced by the polynomial c0 + c1x + c2x^2 + 
+    //! c3x^3 + c4x^4, before any other post-processing.  The polynomial is 
+    //! pre-evaluated for all 65536 possible counts when the spectrometer is 
+    //! opened, so correction costs one table lookup per pixel, made while 
+    //! the spectrum is demarshalled.  When averaging scans, the averaged 
+    //! counts are corrected (interpolating the table).  Never applied to raw 
+    //! spectra.  Disabled by default.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to enable, zero to disable
+    //! @returns WP_SUCCESS, WP_ERROR_NO_CALIBRATION (if the EEPROM has no 
+    //!          valid nonlinearity coefficients) or non-zero on error
+    DLL_API int wp_set_processing_nonlinearity_correction(int specIndex, int flag);
+
+    //! Subtract a smooth baseline (e.g. fluorescence) from every spectrum.
+    //!
+    //! The baseline is the smoothest curve (penalizing its second difference
+    //! by 'lambda') fitting the spectrum under asymmetric weights, which are
+    //! refined for up to 'maxIterations' iterations.  ALS weights points 
+    //! above the baseline by 'p' and those below by 1 - p; airPLS weights 
+    //! points above by zero and adapts the rest automatically (ignoring 'p').
+    //! Each iteration is a banded solve linear in the number of pixels.
+    //!
+    //! Applied after all other post-processing (but before resampling onto 
+    //! an output axis).  Never applied to raw spectra.  Disabled by default.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param method (Input) WP_BASELINE_NONE, WP_BASELINE_ALS or WP_BASELINE_AIRPLS
+    //! @param lambda (Input) smoothness (typically 1e4 to 1e7)
+    //! @param p (Input) ALS asymmetry (typically 0.001 to 0.05)
+    //! @param maxIterations (Input) typically 10 (ALS) or 15 (airPLS)
+    //! @returns WP_SUCCESS or non-zero on error (invalid parameters)
+    DLL_API int wp_set_processing_baseline_removal(int specIndex, int method, double lambda, double p, int maxIterations);
+
+    //! Smooth (or differentiate) every spectrum with a Savitzky-Golay filter.
+    //!
+    //! Each pixel is replaced by the value (or given derivative, per pixel)
+    //! at that pixel of a polynomial least-squares fit to the surrounding
+    //! 2 * halfWidth + 1 pixels.  Within halfWidth of either end, the fit to
+    //! the first or last full window is used, so edges are not truncated.
+    //! Order 0 is a boxcar (moving average).  The filter's coefficients are
+    //! computed once, when this is called.
+    //!
+    //! Applied after dark subtraction and Raman intensity correction (or the
+    //! processing mode's ratio), and before baseline removal.  Never applied
+    //! to raw spectra.  Disabled by default.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param halfWidth (Input) pixels either side of center (0 to disable)
+    //! @param order (Input) polynomial order (0 to 10, less than the window)
+    //! @param derivative (Input) 0 to smooth, else which derivative (up to order)
+    //! @returns WP_SUCCESS or non-zero on error (invalid parameters)
+    DLL_API int wp_set_processing_savitzky_golay(int specIndex, int halfWidth, int order, int derivative);
+
+    //! Acquire a spectrum and store it as the dark, subtracted from every 
+    //! subsequent spectrum until cleared.
+    //!
+    //! The dark is averaged (per wp_set_scans_to_average) and corrected 
+    //! exactly as the spectra it will be subtracted from.  The caller is 
+    //! responsible for blocking the light (or disabling the laser).  Stored
+    //! darks are forgotten when the spectrometer is closed.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS, WP_ERROR_BUSY or non-zero on error
+    DLL_API int wp_store_dark(int specIndex);
+
+    //! Stop subtracting a stored dark.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_clear_dark(int specIndex);
+
+    //! Acquire a spectrum and store it as the reference (e.g. a white 
+    //! standard or blank), against which spectra are ratioed in the 
+    //! transmission, reflectance and absorbance processing modes.
+    //!
+    //! Acquired exactly as wp_store_dark.  The reference is dark-corrected
+    //! when used, so a dark may be stored before or after it.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS, WP_ERROR_BUSY or non-zero on error
+    DLL_API int wp_store_reference(int specIndex);
+
+    //! Forget the stored reference (reverting to WP_PROCESSING_MODE_SCOPE).
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_clear_reference(int specIndex);
+
+    //! Select what wp_get_spectrum reports.
+    //!
+    //! In WP_PROCESSING_MODE_SCOPE, spectra are intensities (less any stored
+    //! dark, and Raman intensity corrected if enabled).  Transmission and 
+    //! reflectance report 100 * (sample - dark) / (reference - dark), and 
+    //! absorbance -log10((sample - dark) / (reference - dark)).  Raman 
+    //! intensity correction is not applied in these modes (it would cancel).
+    //!
+    //! The reciprocal of each pixel's denominator is precomputed whenever 
+    //! the dark, reference or mode changes, and combined with the dark into
+    //! one offset and gain per pixel applied in the single fused 
+    //! post-processing pass, so each spectrum costs one subtract and one 
+    //! multiply per pixel (plus a logarithm for absorbance).  Pixels where
+    //! the reference does not exceed the dark report zero.  Absorbance is
+    //! capped at 6 (a ratio of 1e-6), so those pixels, and any where the
+    //! sample does not exceed the dark, report 6 rather than infinity or 
+    //! NaN (which smoothing and baseline removal would spread to their 
+    //! neighbours).
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param mode (Input) WP_PROCESSING_MODE_SCOPE (default), 
+    //!        WP_PROCESSING_MODE_TRANSMISSION, WP_PROCESSING_MODE_REFLECTANCE 
+    //!        or WP_PROCESSING_MODE_ABSORBANCE
+    //! @returns WP_SUCCESS, WP_ERROR_NO_CALIBRATION (no reference stored) or
+    //!          non-zero on error
+    DLL_API int wp_set_processing_mode(int specIndex, int mode);
+
+    //! @param specIndex (Input) which spectrometer
+    //! @returns the current WP_PROCESSING_MODE_*, or negative on error
+    DLL_API int wp_get_processing_mode(int specIndex);
+
+    //! Resample every spectrum onto an evenly-spaced wavelength or wavenumber
+    //! axis, so that any number of spectrometers report directly comparable 
+    //! arrays.
+    //!
+    //! Interpolation indices and weights are computed once, here, from the 
+    //! spectrometer's wavecal; each spectrum is then post-processed as normal
+    //! and linearly interpolated onto the new axis in a single pass, straight
+    //! into the caller's buffer.  Points beyond either end of the detector 
+    //! take the value of the first or last pixel.
+    //!
+    //! Applies to wp_get_spectrum (and its floating-point variants, including
+    //! continuous acquisition and wp_acquire_all), which then return 'count'
+    //! points rather than wp_get_pixels.  Raw spectra are never resampled.  
+    //! May not be changed while continuous acquisition is running.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param start (Input) x-coordinate of the first output point
+    //! @param step (Input) spacing between output points (positive)
+    //! @param count (Input) number of output points (0 to return native pixels)
+    //! @param units (Input) WP_AXIS_WAVELENGTH_NM or WP_AXIS_WAVENUMBER_CM
+    //! @returns WP_SUCCESS, WP_ERROR_NO_LASER (wavenumbers requested with no 
+    //!          excitation), WP_ERROR_BUSY or non-zero on error
+    //! @see wp_get_spectrum_length
+    DLL_API int wp_set_output_axis(int specIndex, double start, double step, int count, int units);
+
+    //! Time each post-processing stage individually.
+    //!
+    //! Normally all enabled per-pixel stages (bad-pixel correction, 2x2 
+    //! binning, dark subtraction, Raman intensity correction or the ratio 
+    //! against a reference) are fused into a single pass over the spectrum
+    //! (followed by any smoothing and baseline removal), and only the "total"
+    //! stage is timed.  While profiling, each stage is
+    //! instead applied as its own pass and timed separately (with identical
+    //! results, only slower).  Enabling or disabling profiling resets all
+    //! timing.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to enable, zero to disable (default)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_processing_profiling(int specIndex, int flag);
+
+    //! @param specIndex (Input) which spectrometer
+    //! @returns number of timed post-processing stages (including "total")
+    DLL_API int wp_get_processing_stage_count(int specIndex);
+
+    //! @param specIndex (Input) which spectrometer
+    //! @param index (Input) stage index (0 to wp_get_processing_stage_count - 1)
+    //! @param value (Output) a pre-allocated character array to hold the name
+    //! @param len (Input) length of pre-allocated array
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_get_processing_stage_name(int specIndex, int index, char* value, int len);
+
+    //! Get the mean time spent in a post-processing stage per spectrum.
+    //!
+    //! @see wp_set_processing_profiling
+    //! @param specIndex (Input) which spectrometer
+    //! @param index (Input) stage index (0 to wp_get_processing_stage_count - 1)
+    //! @returns mean microseconds per spectrum (0 if not yet timed), negative on error
+    DLL_API float wp_get_processing_stage_time_us(int specIndex, int index);
+
+    //! Apply a Savitzky-Golay filter to an arbitrary array.
+    //!
+    //! @see wp_set_processing_savitzky_golay
+    //! @param spectrum (Input) intensities
+    //! @param output (Output) pre-allocated array of 'len' values (may be 'spectrum')
+    //! @param len (Input) length of both arrays (at least 2 * halfWidth + 1)
+    //! @param halfWidth (Input) pixels either side of center
+    //! @param order (Input) polynomial order (0 to 10, less than the window)
+    //! @param derivative (Input) 0 to smooth, else which derivative (up to order)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_savitzky_golay(const double* spectrum, double* output, int len, int halfWidth, int order, int derivative);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Peakfinding
+    ////////////////////////////////////////////////////////////////////////////
+
+    //! Find peaks in a spectrum.
+    //!
+    //! Peaks are local maxima, characterized as in scipy.signal.find_peaks:
+    //! prominence is the apex height above the higher of the two lowest 
+    //! points reached before anything taller on either side, and width is
+    //! measured at half that prominence.  Each peak's position is refined to
+    //! the intensity-weighted centroid of the pixels above that line, and 
+    //! reported in pixels, nm and cm-1 using the spectrometer's calibration.
+    //!
+    //! The spectrum may either be native pixels, or resampled onto the 
+    //! current output axis (as returned by wp_get_spectrum), in which case
+    //! 'pixel' is the fractional index along that axis.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Input) intensities
+    //! @param len (Input) wp_get_pixels or wp_get_spectrum_length
+    //! @param params (Input) constraints on reported peaks (NULL for none)
+    //! @param peaks (Output) pre-allocated array of 'maxPeaks' peaks
+    //! @param maxPeaks (Input) capacity of 'peaks' (the most prominent are kept)
+    //! @returns number of peaks found (in order of position), negative on error
+    DLL_API int wp_find_peaks(int specIndex, const double* spectrum, int len, const WPPeakParams* params, WPPeak* peaks, int maxPeaks);
+
+    //! Acquire a spectrum (as wp_get_spectrum) and return only its peaks.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param params (Input) constraints on reported peaks (NULL for none)
+    //! @param peaks (Output) pre-allocated array of 'maxPeaks' peaks
+    //! @param maxPeaks (Input) capacity of 'peaks'
+    //! @returns number of peaks found, WP_ERROR_BUSY during continuous 
+    //!          acquisition, negative on error
+    //! @see wp_find_peaks
+    DLL_API int wp_get_spectrum_peaks(int specIndex, const WPPeakParams* params, WPPeak* peaks, int maxPeaks);
+
+    //! Fit a line shape to each of a set of peaks in a spectrum.
+    //!
+    //! Each peak is fit independently by Levenberg-Marquardt over a window of
+    //! +/- 1.5 FWHM about its initial guess, with a linear local baseline.
+    //! Windows are distributed across a pool of worker threads (see 
+    //! wp_set_peak_fit_threads).  Closely overlapping peaks are not fit 
+    //! jointly, so may bias one another.
+    //!
+    //! Guesses are typically the output of wp_find_peaks: only 'pixel', 
+    //! 'width' and 'prominence' are used, and a non-positive width or 
+    //! prominence is estimated from the spectrum.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Input) intensities (native pixels, or resampled onto
+    //!        the current output axis)
+    //! @param len (Input) wp_get_pixels or wp_get_spectrum_length
+    //! @param shape (Input) WP_PEAK_SHAPE_GAUSSIAN, WP_PEAK_SHAPE_LORENTZIAN
+    //!        or WP_PEAK_SHAPE_PSEUDO_VOIGT
+    //! @param guesses (Input) initial estimate of each of 'count' peaks
+    //! @param fits (Output) pre-allocated array of 'count' fits, in the same
+    //!        order as 'guesses'
+    //! @param count (Input) number of peaks
+    //! @returns number of fits which converged, negative on error
+    DLL_API int wp_fit_peaks(int specIndex, const double* spectrum, int len, int shape, const WPPeak* guesses, WPPeakFit* fits, int count);
+
+    //! Set how many threads wp_fit_peaks uses (including the caller's).
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param threads (Input) total threads, or 0 for one per core (up to 8, 
+    //!        the default)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_peak_fit_threads(int specIndex, int threads);
+
     ////////////////////////////////////////////////////////////////////////////
     // Convenience accessors
     ////////////////////////////////////////////////////////////////////////////
@@ -302,6 +815,15 @@ extern "C"
     //! @returns the number of pixels (negative on error)
     DLL_API int wp_get_pixels(int specIndex);
 
+    //! Get the number of points in spectra returned by wp_get_spectrum.
+    //!
+    //! This is wp_get_pixels, unless an output axis has been set.
+    //!
+    //! @see wp_set_output_axis
+    //! @param specIndex (Input) which spectrometer
+    //! @returns number of points
+    DLL_API int wp_get_spectrum_length(int specIndex);
+
     //! Get the selected spectrometer's model.
     //!
     //! @note convenience function around eepromFields["model"]
@@ -379,6 +901,82 @@ extern "C"
     //! @returns WP_SUCCESS or non-zero on error
     DLL_API int wp_get_spectrum_float(int specIndex, float* spectrum, int len);
 
+    //! Read one spectrum, as wp_get_spectrum, along with its metadata.
+    //!
+    //! The metadata is gathered from timestamps and counters kept during 
+    //! acquisition, and settings the driver has cached, so costs no more 
+    //! than wp_get_spectrum.  A gap between consecutive sequence numbers, or
+    //! an increase in drops, indicates an acquisition which produced no 
+    //! spectrum.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Output) pre-allocated buffer of 'len' doubles 
+    //! @param len (Input) allocated length of 'spectrum' (wp_get_spectrum_length)
+    //! @param metadata (Output) pointer to a struct to fill
+    //! @returns WP_SUCCESS, WP_ERROR_BUSY during continuous acquisition, or 
+    //!          non-zero on error
+    DLL_API int wp_get_spectrum_ex(int specIndex, double* spectrum, int len, WPSpectrumMetadata* metadata);
+
+    //! Read one spectrum from the selected spectrometer as raw 16-bit ADC counts
+    //!
+    //! This is the same acquisition as wp_get_spectrum, but pixels are returned
+    //! as the demarshalled little-endian words read from the spectrometer 
+    //! rather than being widened to floating-point (a quarter of the memory
+    //! traffic of wp_get_spectrum, and convenient for archival).
+    //!
+    //! If requested, the X-axis is inverted (where configured in the EEPROM)
+    //! and bad pixels are interpolated in integer arithmetic, rounding to the
+    //! nearest count.  2x2 binning is not applied.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Output) pre-allocated buffer of 'len' unsigned shorts
+    //! @param len (Input) allocated length of 'spectrum' (should match 'pixels')
+    //! @param postProcess (Input) non-zero to apply invert-X and bad-pixel 
+    //!        correction, zero for exactly the words read over USB
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_get_spectrum_raw_u16(int specIndex, unsigned short* spectrum, int len, int postProcess);
+
+    //! Send an "ACQUIRE" command to the selected spectrometer, without reading
+    //! the resulting spectrum.
+    //!
+    //! This allows several spectrometers to be triggered as closely together
+    //! as possible, with their spectra then read through wp_read_spectrum.  
+    //! Every trigger must be followed by exactly one wp_read_spectrum.
+    //!
+    //! @see wp_acquire_all
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_send_software_trigger(int specIndex);
+
+    //! Read one spectrum previously triggered by wp_send_software_trigger.
+    //!
+    //! This is wp_get_spectrum without the "ACQUIRE" command; the blocking 
+    //! read and post-processing are identical.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Output) pre-allocated buffer of 'len' doubles
+    //! @param len (Input) allocated length of 'spectrum' (should match 'pixels')
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_read_spectrum(int specIndex, double* spectrum, int len);
+
+    //! Acquire one spectrum from each of the first 'count' spectrometers, as
+    //! nearly simultaneously as possible.
+    //!
+    //! All spectrometers are sent "ACQUIRE" back-to-back, and only then are
+    //! their spectra read (in parallel).  The time each trigger was sent is 
+    //! returned, so the remaining skew between spectra can be measured.
+    //!
+    //! @param spectra (Output) array of 'count' pre-allocated buffers, where
+    //!        spectra[i] receives the spectrum from specIndex i
+    //! @param lens (Input) allocated length of each spectra[i]
+    //! @param triggerTimestampsUS (Output) array of 'count' timestamps, in 
+    //!        microseconds from an arbitrary (monotonic) epoch, at which each 
+    //!        spectrometer was triggered (0 if it could not be)
+    //! @param count (Input) number of spectrometers (specIndex 0 to count-1)
+    //! @returns WP_SUCCESS if every spectrometer returned a spectrum, else 
+    //!          non-zero
+    DLL_API int wp_acquire_all(double** spectra, const int* lens, long long* triggerTimestampsUS, int count);
+
     //! If an acquisition is currently in progress, cancel it.
     //!
     //! Note that while this function will return instantly, the current
@@ -430,6 +1028,176 @@ extern "C"
     //! @returns configured maximum timeout (ms)
     DLL_API int wp_get_max_timeout_ms(int specIndex);
 
+    //! Configure how many USB bulk transfers are kept "in flight" while
+    //! reading each spectrum.
+    //!
+    //! By default (0), spectra are read with a single blocking transfer per
+    //! bulk endpoint, leaving the USB host controller idle between the
+    //! completion of one read and the submission of the next.  With a non-zero
+    //! count, each endpoint read is split into that many packet-aligned
+    //! asynchronous transfers submitted together, which can noticeably raise
+    //! sustained throughput at short integration times.  Returned spectra are
+    //! identical either way.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param count (Input) concurrent transfers (0 for blocking reads, max 32;
+    //!        4-8 is typically plenty)
+    //! @returns WP_SUCCESS, WP_ERROR_BUSY (while wp_start_triggered is 
+    //!          awaiting triggers) or non-zero on error (including for 
+    //!          simulated or replayed spectrometers, which only support 
+    //!          blocking reads)
+    DLL_API int wp_set_async_bulk_transfers(int specIndex, int count);
+
+    //! Get the number of USB bulk transfers kept "in flight" per spectral read.
+    //!
+    //! @see wp_set_async_bulk_transfers
+    //! @param specIndex (Input) which spectrometer
+    //! @returns configured count (0 for blocking reads), or negative on error
+    DLL_API int wp_get_async_bulk_transfers(int specIndex);
+
+    //! Average multiple scans within each spectrum returned by wp_get_spectrum
+    //! (and its variants, including continuous acquisition).
+    //!
+    //! Each scan's raw pixel values are summed in integer arithmetic inside the
+    //! driver, and only the averaged spectrum is post-processed and returned,
+    //! saving the caller n-1 calls and conversions per spectrum.  The next 
+    //! scan is triggered before the current one is summed, so summation 
+    //! overlaps the following integration.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param n (Input) scans per spectrum (1 to disable averaging, max 65535)
+    //! @returns WP_SUCCESS, WP_ERROR_BUSY (while wp_start_triggered is 
+    //!          awaiting triggers) or non-zero on error
+    DLL_API int wp_set_scans_to_average(int specIndex, int n);
+
+    //! Get the number of scans averaged within each spectrum.
+    //!
+    //! @see wp_set_scans_to_average
+    //! @param specIndex (Input) which spectrometer
+    //! @returns scans per spectrum, or negative on error
+    DLL_API int wp_get_scans_to_average(int specIndex);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Continuous Acquisition
+    ////////////////////////////////////////////////////////////////////////////
+
+    //! Start free-running acquisition on the selected spectrometer.
+    //!
+    //! A background thread will repeatedly trigger and read spectra, storing
+    //! them into a ring of 'depth' pre-allocated spectra which the caller
+    //! drains through wp_read_next_spectrum.  The time between spectra is then
+    //! limited only by integration time and USB transfer, not by how quickly
+    //! the caller processes each spectrum.
+    //!
+    //! If the caller falls far enough behind that the ring is full, newly read
+    //! spectra are discarded and counted (see wp_get_continuous_overruns).
+    //!
+    //! While running, wp_get_spectrum and wp_get_spectrum_float will return
+    //! WP_ERROR_BUSY.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param depth (Input) how many spectra the ring can hold (must be >= 1)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_start_continuous(int specIndex, int depth);
+
+    //! Start hardware-triggered acquisition on the selected spectrometer.
+    //!
+    //! The spectrometer is switched to its external trigger input, and a 
+    //! background thread keeps an asynchronous USB read pending (with no 
+    //! timeout) for the spectrum of each trigger.  While idle, that thread 
+    //! sleeps until the spectrum arrives (consuming no CPU), so triggers may
+    //! be milliseconds or hours apart.  Spectra are post-processed and stored
+    //! into a ring exactly as by wp_start_continuous, to be drained through
+    //! wp_read_next_spectrum (or wp_read_next_spectrum_timestamped, to learn
+    //! when each arrived).  With scan averaging, each spectrum averages that
+    //! many consecutive triggers.
+    //!
+    //! On USB spectrometers, asynchronous bulk transfers are enabled if they
+    //! weren't already (see wp_set_async_bulk_transfers), and may not be 
+    //! changed while triggered.
+    //! wp_stop_continuous stops waiting and restores internal triggering.
+    //!
+    //! ARM-based spectrometers provide no command to select the external
+    //! trigger input, so are not supported: this fails (logging why) rather
+    //! than waiting for spectra which would never arrive.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param depth (Input) how many spectra the ring can hold (must be >= 1)
+    //! @returns WP_SUCCESS or non-zero on error (including on ARM units)
+    DLL_API int wp_start_triggered(int specIndex, int depth);
+
+    //! Stop free-running (or triggered) acquisition on the selected 
+    //! spectrometer.
+    //!
+    //! Blocks until the background thread has exited.  Spectra already in the
+    //! ring can still be read through wp_read_next_spectrum.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_stop_continuous(int specIndex);
+
+    //! Read the oldest unread spectrum acquired in continuous mode.
+    //!
+    //! Spectra are post-processed exactly as by wp_get_spectrum.  Only one 
+    //! thread should read from a given spectrometer at a time.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Output) pre-allocated buffer of 'len' doubles
+    //! @param len (Input) allocated length of 'spectrum' (should match 'pixels')
+    //! @param timeoutMS (Input) how long to wait for a spectrum (0 to return 
+    //!        immediately, negative to wait indefinitely)
+    //! @returns WP_SUCCESS, WP_ERROR_TIMEOUT if no spectrum arrived in time, or
+    //!          WP_ERROR if continuous acquisition is not running
+    DLL_API int wp_read_next_spectrum(int specIndex, double* spectrum, int len, int timeoutMS);
+
+    //! Read the oldest unread spectrum, and when it was received.
+    //!
+    //! @see wp_read_next_spectrum
+    //! @param specIndex (Input) which spectrometer
+    //! @param spectrum (Output) pre-allocated buffer of 'len' doubles
+    //! @param len (Input) allocated length of 'spectrum'
+    //! @param timeoutMS (Input) as wp_read_next_spectrum
+    //! @param timestampUS (Output) when the host finished receiving the 
+    //!        spectrum over USB, in microseconds on the same monotonic clock
+    //!        as wp_acquire_all's trigger timestamps
+    //! @returns as wp_read_next_spectrum
+    DLL_API int wp_read_next_spectrum_timestamped(int specIndex, double* spectrum, int len, int timeoutMS, long long* timestampUS);
+
+    //! Have the driver call back with each spectrum acquired, rather than 
+    //! the caller polling for them.
+    //!
+    //! The callback runs on a thread of the driver's own (one per 
+    //! spectrometer).  If acquisition isn't already running, free-running 
+    //! acquisition is started with a ring of 8 spectra; to choose the depth, 
+    //! or to wait on hardware triggers, call wp_start_continuous or 
+    //! wp_start_triggered first.
+    //!
+    //! Each spectrum is passed in place, in its slot of the ring: the frame
+    //! is valid only until the callback returns, at which point the slot is
+    //! recycled (copy anything needed for longer).  Acquisition carries on 
+    //! into other slots while the callback runs, so a slow callback costs 
+    //! only dropped spectra (counted in each frame's overruns), never missed
+    //! integrations.  wp_read_next_spectrum returns WP_ERROR while a callback
+    //! is registered.
+    //!
+    //! wp_stop_continuous (or registering a null callback) stops acquisition,
+    //! blocking until any spectra already acquired have been delivered.  
+    //! Neither may be called from within the callback itself.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param callback (Input) called with each spectrum (null to stop)
+    //! @param userData (Input) passed through to every call
+    //! @returns WP_SUCCESS or non-zero on error (e.g. a callback is already
+    //!          registered)
+    DLL_API int wp_register_spectrum_callback(int specIndex, WPSpectrumCallback callback, void* userData);
+
+    //! Get the number of spectra discarded since wp_start_continuous because
+    //! the ring was full.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns number of overruns, or negative on error
+    DLL_API int wp_get_continuous_overruns(int specIndex);
+
     ////////////////////////////////////////////////////////////////////////////
     // Opcodes
     ////////////////////////////////////////////////////////////////////////////
@@ -682,6 +1450,52 @@ extern "C"
                                     unsigned char* data,
                                     int len);
 
+    //! Time every USB transfer made to a spectrometer, by opcode.
+    //!
+    //! Control transfers are timed from when the driver first attempts the
+    //! transfer, so include any wait for another thread's transfer to 
+    //! complete (e.g. a temperature read queued behind a setter).  Bulk 
+    //! reads are timed per endpoint, per spectrum, from the first read 
+    //! attempt until all pixels have arrived (so include integration, and
+    //! any wait for a hardware trigger).
+    //!
+    //! Costs well under a microsecond per transfer while enabled, and 
+    //! practically nothing while disabled (the default).
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param flag (Input) non-zero to record latencies
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_set_latency_stats_enable(int specIndex, int flag);
+
+    //! Get latency statistics for each opcode and endpoint timed since 
+    //! enabled (or reset), in ascending order of key.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param stats (Output) pre-allocated array of 'maxStats' entries
+    //! @param maxStats (Input) allocated length of 'stats'
+    //! @returns number of entries populated (extras are dropped), or 
+    //!          negative on error
+    DLL_API int wp_get_latency_stats(int specIndex, WPLatencyStats* stats, int maxStats);
+
+    //! Discard all latencies recorded so far (recording stays enabled).
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_reset_latency_stats(int specIndex);
+
+    //! Get USB transfer counts for a spectrometer, and for its whole bus.
+    //!
+    //! Counts are cumulative: a spectrometer's since it was opened, and a 
+    //! bus's since the first spectrometer on it was opened (including any 
+    //! since closed), so monitoring can difference successive calls.
+    //!
+    //! @param specIndex (Input) which spectrometer
+    //! @param device (Output) counts for this spectrometer (may be null)
+    //! @param bus (Output) counts summed over all spectrometers on the same
+    //!        USB bus (may be null)
+    //! @returns WP_SUCCESS or non-zero on error
+    DLL_API int wp_get_usb_stats(int specIndex, WPUsbStats* device, WPUsbStats* bus);
+
     //! Obviously shouldn't have to do this, but adding to work with developmental 
     //! spectrometers and firmware.
     DLL_API void wp_set_driver_delay_us(unsigned long delay_us = 0);
@@ -921,6 +1735,27 @@ namespace WasatchVCPP
                 int readControlMsg(uint8_t bRequest, uint16_t wIndex, uint8_t* data, int len)
                 { return wp_read_control_msg(specIndex, bRequest, wIndex, data, len); }
 
+                //! @see wp_set_latency_stats_enable
+                bool setLatencyStatsEnable(bool flag)
+                { return WP_SUCCESS == wp_set_latency_stats_enable(specIndex, flag); }
+
+                //! @see wp_get_latency_stats
+                std::vector<WPLatencyStats> getLatencyStats(int maxStats = 256)
+                {
+                    std::vector<WPLatencyStats> stats(maxStats);
+                    int count = wp_get_latency_stats(specIndex, stats.data(), maxStats);
+                    stats.resize(count > 0 ? count : 0);
+                    return stats;
+                }
+
+                //! @see wp_reset_latency_stats
+                bool resetLatencyStats()
+                { return WP_SUCCESS == wp_reset_latency_stats(specIndex); }
+
+                //! @see wp_get_usb_stats
+                bool getUsbStats(WPUsbStats& device, WPUsbStats& bus)
+                { return WP_SUCCESS == wp_get_usb_stats(specIndex, &device, &bus); }
+
                 //! @see wp_set_max_timeout_ms
                 bool setMaxTimeoutMS(int maxTimeoutMS)
                 { return WP_SUCCESS == wp_set_max_timeout_ms(specIndex, maxTimeoutMS); }
@@ -929,6 +1764,167 @@ namespace WasatchVCPP
                 int getMaxTimeoutMS()
                 { return wp_get_max_timeout_ms(specIndex); }
 
+                //! @see wp_set_async_bulk_transfers
+                bool setAsyncBulkTransfers(int count)
+                { return WP_SUCCESS == wp_set_async_bulk_transfers(specIndex, count); }
+
+                //! @see wp_get_async_bulk_transfers
+                int getAsyncBulkTransfers()
+                { return wp_get_async_bulk_transfers(specIndex); }
+
+                //! @see wp_set_raman_intensity_correction_enable
+                bool setRamanIntensityCorrectionEnable(bool flag)
+                { return WP_SUCCESS == wp_set_raman_intensity_correction_enable(specIndex, flag); }
+
+                //! @see wp_get_raman_intensity_correction_enable
+                bool getRamanIntensityCorrectionEnable()
+                { return 1 == wp_get_raman_intensity_correction_enable(specIndex); }
+
+                //! @see wp_set_processing_invert_x
+                bool setProcessingInvertX(bool flag)
+                { return WP_SUCCESS == wp_set_processing_invert_x(specIndex, flag); }
+
+                //! @see wp_set_processing_bad_pixel_correction
+                bool setProcessingBadPixelCorrection(bool flag)
+                { return WP_SUCCESS == wp_set_processing_bad_pixel_correction(specIndex, flag); }
+
+                //! @see wp_set_processing_bin_2x2
+                bool setProcessingBin2x2(bool flag)
+                { return WP_SUCCESS == wp_set_processing_bin_2x2(specIndex, flag); }
+
+                //! @see wp_set_processing_nonlinearity_correction
+                bool setProcessingNonlinearityCorrection(bool flag)
+                { return WP_SUCCESS == wp_set_processing_nonlinearity_correction(specIndex, flag); }
+
+                //! @see wp_set_processing_savitzky_golay
+                bool setProcessingSavitzkyGolay(int halfWidth, int order, int derivative = 0)
+                { return WP_SUCCESS == wp_set_processing_savitzky_golay(specIndex, halfWidth, order, derivative); }
+
+                //! @see wp_set_processing_baseline_removal
+                bool setProcessingBaselineRemoval(int method, double lambda = 1e5, double p = 0.01, int maxIterations = 10)
+                { return WP_SUCCESS == wp_set_processing_baseline_removal(specIndex, method, lambda, p, maxIterations); }
+
+                //! @see wp_store_dark
+                bool storeDark()
+                { return WP_SUCCESS == wp_store_dark(specIndex); }
+
+                //! @see wp_clear_dark
+                bool clearDark()
+                { return WP_SUCCESS == wp_clear_dark(specIndex); }
+
+                //! @see wp_store_reference
+                bool storeReference()
+                { return WP_SUCCESS == wp_store_reference(specIndex); }
+
+                //! @see wp_clear_reference
+                bool clearReference()
+                { return WP_SUCCESS == wp_clear_reference(specIndex); }
+
+                //! @see wp_set_processing_mode
+                bool setProcessingMode(int mode)
+                { return WP_SUCCESS == wp_set_processing_mode(specIndex, mode); }
+
+                //! @see wp_get_processing_mode
+                int getProcessingMode()
+                { return wp_get_processing_mode(specIndex); }
+
+                //! @see wp_set_output_axis
+                bool setOutputAxis(double start, double step, int count, int units)
+                {
+                    if (WP_SUCCESS != wp_set_output_axis(specIndex, start, step, count, units))
+                        return false;
+                    spectrumBuf.resize(wp_get_spectrum_length(specIndex));
+                    return true;
+                }
+
+                //! @see wp_set_processing_profiling
+                bool setProcessingProfiling(bool flag)
+                { return WP_SUCCESS == wp_set_processing_profiling(specIndex, flag); }
+
+                //! @returns mean microseconds per spectrum of each stage, by name
+                //! @see wp_get_processing_stage_time_us
+                std::map<std::string, float> getProcessingStageTimesUS()
+                {
+                    std::map<std::string, float> times;
+                    int count = wp_get_processing_stage_count(specIndex);
+                    for (int i = 0; i < count; i++)
+                    {
+                        char name[64];
+                        if (WP_SUCCESS == wp_get_processing_stage_name(specIndex, i, name, sizeof(name)))
+                            times[name] = wp_get_processing_stage_time_us(specIndex, i);
+                    }
+                    return times;
+                }
+
+                //! @see wp_find_peaks
+                std::vector<WPPeak> findPeaks(const std::vector<double>& spectrum, const WPPeakParams& params, int maxPeaks = 64)
+                {
+                    std::vector<WPPeak> peaks(maxPeaks);
+                    int count = wp_find_peaks(specIndex, spectrum.data(), (int)spectrum.size(), &params, peaks.data(), maxPeaks);
+                    peaks.resize(count > 0 ? count : 0);
+                    return peaks;
+                }
+
+                //! @see wp_get_spectrum_peaks
+                std::vector<WPPeak> getSpectrumPeaks(const WPPeakParams& params, int maxPeaks = 64)
+                {
+                    std::vector<WPPeak> peaks(maxPeaks);
+                    int count = wp_get_spectrum_peaks(specIndex, &params, peaks.data(), maxPeaks);
+                    peaks.resize(count > 0 ? count : 0);
+                    return peaks;
+                }
+
+                //! @see wp_fit_peaks
+                std::vector<WPPeakFit> fitPeaks(const std::vector<double>& spectrum, int shape, const std::vector<WPPeak>& guesses)
+                {
+                    std::vector<WPPeakFit> fits(guesses.size());
+                    if (guesses.empty() || wp_fit_peaks(specIndex, spectrum.data(), (int)spectrum.size(), shape, guesses.data(), fits.data(), (int)fits.size()) < 0)
+                        fits.clear();
+                    return fits;
+                }
+
+                //! @see wp_set_peak_fit_threads
+                bool setPeakFitThreads(int threads)
+                { return WP_SUCCESS == wp_set_peak_fit_threads(specIndex, threads); }
+
+                //! @see wp_set_scans_to_average
+                bool setScansToAverage(int n)
+                { return WP_SUCCESS == wp_set_scans_to_average(specIndex, n); }
+
+                //! @see wp_get_scans_to_average
+                int getScansToAverage()
+                { return wp_get_scans_to_average(specIndex); }
+
+                //! @see wp_start_continuous
+                bool startContinuous(int depth)
+                { return WP_SUCCESS == wp_start_continuous(specIndex, depth); }
+
+                //! @see wp_start_triggered
+                bool startTriggered(int depth)
+                { return WP_SUCCESS == wp_start_triggered(specIndex, depth); }
+
+                //! @see wp_stop_continuous
+                bool stopContinuous()
+                { return WP_SUCCESS == wp_stop_continuous(specIndex); }
+
+                //! @see wp_read_next_spectrum
+                //! @returns spectrum (empty on timeout or error)
+                std::vector<double> readNextSpectrum(int timeoutMS = -1)
+                {
+                    std::vector<double> spectrum(spectrumBuf.size());
+                    if (WP_SUCCESS != wp_read_next_spectrum(specIndex, &spectrum[0], (int)spectrum.size(), timeoutMS))
+                        spectrum.clear();
+                    return spectrum;
+                }
+
+                //! @see wp_register_spectrum_callback
+                bool registerSpectrumCallback(WPSpectrumCallback callback, void* userData = nullptr)
+                { return WP_SUCCESS == wp_register_spectrum_callback(specIndex, callback, userData); }
+
+                //! @see wp_get_continuous_overruns
+                int getContinuousOverruns()
+                { return wp_get_continuous_overruns(specIndex); }
+
                 //! @see wp_cancel_operation
                 bool cancelOperation(bool blocking=false)
                 { return WP_SUCCESS == wp_cancel_operation(specIndex, blocking ? 1 : 0); }
@@ -960,11 +1956,45 @@ namespace WasatchVCPP
                 {
                     std::vector<double> result;
                     if (pixels > 0)
-                        if (WP_SUCCESS == wp_get_spectrum(specIndex, &(spectrumBuf[0]), pixels))
+                        if (WP_SUCCESS == wp_get_spectrum(specIndex, &(spectrumBuf[0]), (int)spectrumBuf.size()))
+                            result = spectrumBuf;
+                    return result;
+                }
+
+                //! @see wp_get_spectrum_ex
+                //! @returns spectrum as vector of doubles (empty on error)
+                std::vector<double> getSpectrum(WPSpectrumMetadata& metadata)
+                {
+                    std::vector<double> result;
+                    if (pixels > 0)
+                        if (WP_SUCCESS == wp_get_spectrum_ex(specIndex, &(spectrumBuf[0]), (int)spectrumBuf.size(), &metadata))
                             result = spectrumBuf;
                     return result;
                 }
 
+                //! @see wp_send_software_trigger
+                bool sendSoftwareTrigger()
+                { return WP_SUCCESS == wp_send_software_trigger(specIndex); }
+
+                //! @see wp_read_spectrum
+                std::vector<double> readSpectrum()
+                {
+                    std::vector<double> result;
+                    if (pixels > 0)
+                        if (WP_SUCCESS == wp_read_spectrum(specIndex, &(spectrumBuf[0]), (int)spectrumBuf.size()))
+                            result = spectrumBuf;
+                    return result;
+                }
+
+                //! @see wp_get_spectrum_raw_u16
+                std::vector<uint16_t> getSpectrumRaw(bool postProcess = true)
+                {
+                    std::vector<uint16_t> result(pixels > 0 ? pixels : 0);
+                    if (pixels <= 0 || WP_SUCCESS != wp_get_spectrum_raw_u16(specIndex, &result[0], pixels, postProcess ? 1 : 0))
+                        result.clear();
+                    return result;
+                }
+
                 //! @see wp_get_eeprom_page
                 std::vector<uint8_t> getEEPROMPage(int page)
                 {
@@ -1059,6 +2089,14 @@ namespace WasatchVCPP
                     return std::string(buf);
                 }
 
+                //! @see wp_set_simulated_spectrometers
+                bool setSimulatedSpectrometers(int count, int pixels = 1024, float latencyScale = 1)
+                { return WP_SUCCESS == wp_set_simulated_spectrometers(count, pixels, latencyScale); }
+
+                //! @see wp_set_usb_capture
+                bool setUsbCapture(const std::string& prefix)
+                { return WP_SUCCESS == wp_set_usb_capture(prefix.c_str(), (int)prefix.size()); }
+
                 //! @see wp_open_all_spectrometers()
                 int openAllSpectrometers()
                 {
@@ -1083,6 +2121,16 @@ namespace WasatchVCPP
                     return validCount;
                 }
 
+                //! @see wp_open_replay
+                //! @returns the replayed spectrometer's index, or negative on error
+                int openReplay(const std::string& pathname, bool realTime = false)
+                {
+                    int index = wp_open_replay(pathname.c_str(), (int)pathname.size(), realTime ? 1 : 0);
+                    if (index >= 0)
+                        spectrometers.insert(std::make_pair(index, new Proxy::Spectrometer(index)));
+                    return index;
+                }
+
                 //! Retrieve a handle to one Spectrometer.
                 //! 
                 //! @peram specIndex (Input) which spectrometer (less than numberOfSpectrometers)